@@ -0,0 +1,47 @@
+#ifndef __ALIGNED_ALLOCATOR_H__
+#define __ALIGNED_ALLOCATOR_H__
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+//
+// Standard allocator that aligns every allocation to Alignment bytes
+// (a cache line by default), so that batch kernels can use aligned
+// vector loads from the start of a buffer.
+//
+template <typename ValueType, std::size_t Alignment=64>
+class AlignedAllocator
+{
+public:
+  typedef ValueType value_type;
+
+  template <typename OtherType>
+  struct rebind
+  { typedef AlignedAllocator<OtherType, Alignment> other; };
+
+  AlignedAllocator () noexcept = default;
+
+  template <typename OtherType>
+  AlignedAllocator (const AlignedAllocator<OtherType, Alignment>&) noexcept
+  { }
+
+  ValueType* allocate (std::size_t count)
+  { return static_cast<ValueType*>(::operator new(count*sizeof(ValueType), std::align_val_t{Alignment})); }
+
+  void deallocate (ValueType* ptr, std::size_t) noexcept
+  { ::operator delete(ptr, std::align_val_t{Alignment}); }
+};
+
+template <typename LhsType, typename RhsType, std::size_t Alignment>
+bool operator== (const AlignedAllocator<LhsType, Alignment>&, const AlignedAllocator<RhsType, Alignment>&)
+{ return true; }
+
+template <typename LhsType, typename RhsType, std::size_t Alignment>
+bool operator!= (const AlignedAllocator<LhsType, Alignment>&, const AlignedAllocator<RhsType, Alignment>&)
+{ return false; }
+
+template <typename ValueType>
+using AlignedVector = std::vector<ValueType, AlignedAllocator<ValueType>>;
+
+#endif // __ALIGNED_ALLOCATOR_H__
@@ -0,0 +1,70 @@
+#ifndef __BATCH_VALIDITY_H__
+#define __BATCH_VALIDITY_H__
+
+#include "OmplConcepts.h"
+
+#include <cstddef>
+#include <cstdint>
+
+//
+// Batch validity checking.
+//
+// A checker's isValidMany(states, numStates, outValidMask,
+// stopAtFirstInvalid) checks states[0..numStates) and sets bit
+// (idx % 64) of outValidMask[idx / 64] exactly when states[idx] is
+// valid; the mask needs getValidMaskWords(numStates) words, and may be
+// null when only the count is wanted.  It returns the number of valid
+// states.  With stopAtFirstInvalid it stops at the first invalid
+// state, so the return value is that state's index (or numStates if
+// all are valid), and bits from there on are clear.
+//
+
+constexpr std::size_t getValidMaskWords (std::size_t numStates)
+{ return (numStates + 63)/64; }
+
+inline bool isValidMaskBitSet (const std::uint64_t* validMask, std::size_t idx)
+{ return (validMask[idx/64] >> (idx%64)) & 1; }
+
+inline void clearValidMask (std::uint64_t* validMask, std::size_t numStates)
+{
+  for (std::size_t word = 0; word < getValidMaskWords(numStates); ++word) {
+    validMask[word] = 0;
+  }
+}
+
+//
+// Checks states with validator's isValidMany if it is an
+// OmplBatchValidityChecker, and with one isValid call per state
+// otherwise.
+//
+template <typename ValidatorType>
+std::size_t isValidMany (const ValidatorType&                     validator,
+                         const typename ValidatorType::StateType* states,
+                         std::size_t                              numStates,
+                         std::uint64_t*                           outValidMask,
+                         bool                                     stopAtFirstInvalid = false)
+{
+  if constexpr (OmplBatchValidityChecker<ValidatorType>()) {
+    return validator.isValidMany(states, numStates, outValidMask, stopAtFirstInvalid);
+  }
+  else {
+    if (outValidMask != nullptr) {
+      clearValidMask(outValidMask, numStates);
+    }
+    std::size_t numValid = 0;
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      if (validator.isValid(states[idx])) {
+        ++numValid;
+        if (outValidMask != nullptr) {
+          outValidMask[idx/64] |= std::uint64_t{1} << (idx%64);
+        }
+      }
+      else if (stopAtFirstInvalid) {
+        break;
+      }
+    }
+    return numValid;
+  }
+}
+
+#endif // __BATCH_VALIDITY_H__
@@ -0,0 +1,143 @@
+#ifndef __BOUNDED_RING_BUFFER_H__
+#define __BOUNDED_RING_BUFFER_H__
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+//
+// Fixed-capacity multi-producer, multi-consumer queue without locks
+// (D. Vyukov's bounded MPMC queue).
+//
+// Every cell carries a sequence number that tells producers and
+// consumers whose turn it is, so a push or pop is one compare-and-swap
+// on the shared position plus a store to the cell; threads never wait
+// on each other.  tryPush fails when the queue is full and tryPop when
+// it is empty.
+//
+// Values are moved in and out of cells that live as long as the queue,
+// so for types like Compound::State whose move is a buffer swap, a
+// steady stream of pushes and pops recycles the same buffers instead
+// of allocating.
+//
+template <typename ValueType>
+class BoundedRingBuffer
+{
+public:
+  //
+  // capacity is rounded up to a power of two (at least 2).
+  //
+  explicit BoundedRingBuffer (std::size_t capacity)
+    : _capacity{roundUpToPowerOfTwo(capacity)}
+    , _mask{_capacity - 1}
+    , _cells{new Cell[_capacity]}
+  {
+    for (std::size_t idx = 0; idx < _capacity; ++idx) {
+      _cells[idx].sequence.store(idx, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedRingBuffer (const BoundedRingBuffer& orig)            = delete;
+  BoundedRingBuffer& operator= (const BoundedRingBuffer& orig) = delete;
+  ~BoundedRingBuffer ()                                        = default;
+
+  std::size_t capacity () const
+  { return _capacity; }
+
+  //
+  // A snapshot that may be stale by the time it is returned.
+  //
+  std::size_t approximateSize () const
+  {
+    const std::size_t tail = _tail.load(std::memory_order_relaxed);
+    const std::size_t head = _head.load(std::memory_order_relaxed);
+    return head > tail ? head - tail : 0;
+  }
+
+  bool tryPush (const ValueType& value)
+  {
+    ValueType copy{value};
+    return tryPush(std::move(copy));
+  }
+
+  //
+  // value is moved from only if the push succeeds.
+  //
+  bool tryPush (ValueType&& value)
+  {
+    std::size_t pos;
+    Cell* cell = claim(_head, 0, pos);
+    if (cell == nullptr) {
+      return false;
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPop (ValueType& outValue)
+  {
+    std::size_t pos;
+    Cell* cell = claim(_tail, 1, pos);
+    if (cell == nullptr) {
+      return false;
+    }
+    outValue = std::move(cell->value);
+    cell->sequence.store(pos + _capacity, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct alignas(64) Cell
+  {
+    std::atomic<std::size_t> sequence;
+    ValueType                value;
+  };
+
+  static std::size_t roundUpToPowerOfTwo (std::size_t value)
+  {
+    std::size_t result = 2;
+    while (result < value) {
+      result *= 2;
+    }
+    return result;
+  }
+
+  //
+  // Claim the cell at position, which is ready once its sequence
+  // equals position + lag (0 for producers, 1 for consumers), and
+  // advance position past it.  Returns null if the queue is full (or
+  // empty).
+  //
+  Cell* claim (std::atomic<std::size_t>& position, std::size_t lag, std::size_t& outPos)
+  {
+    std::size_t pos = position.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = _cells[pos & _mask];
+      const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence - (pos + lag));
+      if (diff == 0) {
+        if (position.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          outPos = pos;
+          return &cell;
+        }
+      }
+      else if (diff < 0) {
+        return nullptr;
+      }
+      else {
+        pos = position.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  const std::size_t       _capacity;
+  const std::size_t       _mask;
+  std::unique_ptr<Cell[]> _cells;
+
+  alignas(64) std::atomic<std::size_t> _head{0};
+  alignas(64) std::atomic<std::size_t> _tail{0};
+};
+
+#endif // __BOUNDED_RING_BUFFER_H__
@@ -0,0 +1,250 @@
+#ifndef __BRIDGE_TEST_SAMPLER_H__
+#define __BRIDGE_TEST_SAMPLER_H__
+
+#include "BatchValidity.h"
+#include "RandomNumberGenerator.h"
+#include "SampleBatch.h"
+#include "SpaceHandle.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace Samplers
+{
+  //
+  // Bridge-test sampling (Hsu et al.): draw a uniform sample and a
+  // Gaussian sample near it, and when both are invalid, keep the
+  // midpoint of the two if it is valid.  Such "bridges" span narrow
+  // passages, so the samples concentrate there rather than along every
+  // obstacle boundary, as ValidatingGaussianSampler's do.
+  //
+  // Pairs are drawn kBatchSize at a time into scratch states (see
+  // SampleBatch) and tested in order, stopping at the first check that
+  // fails: a pair with a valid first state costs one validity check,
+  // and the midpoint is only interpolated for pairs whose ends are
+  // both invalid.  Batch-capable checkers (see OmplBatchValidityChecker)
+  // instead check all first states, then the second states of the
+  // pairs whose first state is invalid, then the midpoints of the pairs
+  // whose ends are both invalid, in one call each.  Later sample()
+  // calls return the batch's other valid midpoints before drawing a
+  // new one, whichever stream they are given.  As with
+  // ValidatingGaussianSampler, give each thread its own sampler.
+  //
+  template<typename ValidatorType>
+  class BridgeTestSampler
+  {
+  public:
+    typedef typename ValidatorType::SpaceType SpaceType;
+    typedef typename ValidatorType::StateType StateType;
+
+    static constexpr std::size_t kBatchSize = 64;
+
+    BridgeTestSampler (const ValidatorType& validator, SpaceHandle<SpaceType> spSpace, double stddev)
+      : _validator(validator)
+      , _spSpace(std::move(spSpace))
+      , _stddev(stddev)
+      , _midState(_spSpace->makeState())
+    { }
+
+    BridgeTestSampler (const ValidatorType& validator, SpaceHandle<SpaceType> spSpace, double stddev,
+                       const RandomNumberGenerator& rng)
+      : _validator(validator)
+      , _spSpace(std::move(spSpace))
+      , _stddev(stddev)
+      , _rng(rng)
+      , _midState(_spSpace->makeState())
+    { }
+
+    BridgeTestSampler (const ValidatorType& validator, SpaceType space, double stddev)
+      : BridgeTestSampler(validator, makeSpaceHandle(std::move(space)), stddev)
+    { }
+
+    BridgeTestSampler (const ValidatorType& validator, SpaceType space, double stddev,
+                       const RandomNumberGenerator& rng)
+      : BridgeTestSampler(validator, makeSpaceHandle(std::move(space)), stddev, rng)
+    { }
+
+    BridgeTestSampler (const BridgeTestSampler& orig)            = default;
+    BridgeTestSampler (BridgeTestSampler&& sink)                 = default;
+    BridgeTestSampler& operator= (const BridgeTestSampler& orig) = default;
+    BridgeTestSampler& operator= (BridgeTestSampler&& sink)      = default;
+    ~BridgeTestSampler ()                                        = default;
+
+    const SpaceHandle<SpaceType>& getSpace () const
+    { return _spSpace; }
+
+    const ValidatorType& getValidator () const
+    { return _validator; }
+
+    void setValidator (const ValidatorType& validator)
+    { _validator = validator; }
+
+    //
+    // The number of pairs sample() draws before giving up and
+    // returning false.  0, the default, means it never gives up.
+    //
+    void setMaxAttempts (std::size_t maxAttempts)
+    { _maxAttempts = maxAttempts; }
+
+    std::size_t getMaxAttempts () const
+    { return _maxAttempts; }
+
+    //
+    // The single-argument form draws from the sampler's own stream;
+    // the other draws from the given one.  outState is left unchanged
+    // if no sample is found.
+    //
+    bool sample (StateType& outState) const;
+    bool sample (StateType& outState, RandomNumberGenerator& rng) const;
+
+  private:
+    //
+    // The validity mask of the last batch's midpoints, and the first of
+    // them not yet looked at.  Like the midpoints, it is not copied.
+    //
+    struct CheckedMidStates
+    {
+      std::uint64_t validMask[getValidMaskWords(kBatchSize)];
+      std::size_t   next = 0;
+      std::size_t   size = 0;
+
+      CheckedMidStates () = default;
+
+      CheckedMidStates (const CheckedMidStates&)
+      { }
+
+      CheckedMidStates& operator= (const CheckedMidStates&)
+      {
+        next = size = 0;
+        return *this;
+      }
+    };
+
+    bool findBridge (std::size_t numPairs, StateType& outState, RandomNumberGenerator& rng) const;
+    bool takeCheckedMidState (StateType& outState) const;
+
+    ValidatorType                 _validator;
+    SpaceHandle<SpaceType>        _spSpace;
+    double                        _stddev;
+    std::size_t                   _maxAttempts = 0;
+    mutable RandomNumberGenerator _rng;
+
+    // Scratch: _firstStates[i] and _secondStates[i] are the ends of
+    // the i'th bridge.
+    mutable SampleBatch<SpaceType> _firstStates;
+    mutable SampleBatch<SpaceType> _secondStates;
+    mutable SampleBatch<SpaceType> _midStates;
+    mutable CheckedMidStates       _checkedMidStates;
+    mutable StateType              _midState;
+  };
+
+  template<typename ValidatorType>
+  bool BridgeTestSampler<ValidatorType>::sample (StateType& outState) const
+  { return sample(outState, _rng); }
+
+  template<typename ValidatorType>
+  bool BridgeTestSampler<ValidatorType>::sample (StateType& outState, RandomNumberGenerator& rng) const
+  {
+    if (takeCheckedMidState(outState)) {
+      return true;
+    }
+
+    _firstStates.allocate(*_spSpace, kBatchSize);
+    _secondStates.allocate(*_spSpace, kBatchSize);
+
+    std::size_t attempts = 0;
+    while (_maxAttempts == 0 || attempts < _maxAttempts) {
+      std::size_t numPairs = kBatchSize;
+      if (_maxAttempts != 0 && _maxAttempts - attempts < numPairs) {
+        numPairs = _maxAttempts - attempts;
+      }
+      _firstStates.sampleUniform(*_spSpace, numPairs, rng);
+      attempts += numPairs;
+
+      if (findBridge(numPairs, outState, rng)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  //
+  // Look for a bridge among pairs with the first numPairs first states
+  // of the batch, drawing their second states from rng.
+  //
+  template<typename ValidatorType>
+  bool BridgeTestSampler<ValidatorType>::findBridge (std::size_t numPairs, StateType& outState,
+                                                     RandomNumberGenerator& rng) const
+  {
+    if constexpr (OmplBatchValidityChecker<ValidatorType>()) {
+      std::uint64_t validMask[getValidMaskWords(kBatchSize)];
+      _validator.isValidMany(_firstStates.data(), numPairs, validMask, false);
+
+      // Only pairs with an invalid first state can be bridges, so move
+      // those first states to the front and draw seconds just for them.
+      using std::swap;
+      std::size_t numInvalid = 0;
+      for (std::size_t idx = 0; idx < numPairs; ++idx) {
+        if (!isValidMaskBitSet(validMask, idx)) {
+          if (idx != numInvalid) {
+            swap(_firstStates[numInvalid], _firstStates[idx]);
+          }
+          ++numInvalid;
+        }
+      }
+      if (numInvalid == 0) {
+        return false;
+      }
+      _secondStates.sampleGaussianNear(*_spSpace, _firstStates, _stddev, numInvalid, rng);
+      _validator.isValidMany(_secondStates.data(), numInvalid, validMask, false);
+
+      _midStates.allocate(*_spSpace, kBatchSize);
+      std::size_t numBridges = 0;
+      for (std::size_t idx = 0; idx < numInvalid; ++idx) {
+        if (!isValidMaskBitSet(validMask, idx)) {
+          _spSpace->interpolate(_firstStates[idx], _secondStates[idx], 0.5, _midStates[numBridges++]);
+        }
+      }
+
+      _validator.isValidMany(_midStates.data(), numBridges, _checkedMidStates.validMask, false);
+      _checkedMidStates.next = 0;
+      _checkedMidStates.size = numBridges;
+      return takeCheckedMidState(outState);
+    }
+    else {
+      _secondStates.sampleGaussianNear(*_spSpace, _firstStates, _stddev, numPairs, rng);
+      for (std::size_t idx = 0; idx < numPairs; ++idx) {
+        if (_validator.isValid(_firstStates[idx]) || _validator.isValid(_secondStates[idx])) {
+          continue;
+        }
+        _spSpace->interpolate(_firstStates[idx], _secondStates[idx], 0.5, _midState);
+        if (_validator.isValid(_midState)) {
+          outState = _midState;
+          return true;
+        }
+      }
+      return false;
+    }
+  }
+
+  //
+  // Sets outState to the next valid midpoint of the last batch, if it
+  // has one left.
+  //
+  template<typename ValidatorType>
+  bool BridgeTestSampler<ValidatorType>::takeCheckedMidState (StateType& outState) const
+  {
+    while (_checkedMidStates.next < _checkedMidStates.size) {
+      const std::size_t idx = _checkedMidStates.next++;
+      if (isValidMaskBitSet(_checkedMidStates.validMask, idx)) {
+        outState = _midStates[idx];
+        return true;
+      }
+    }
+    return false;
+  }
+}
+
+#endif // __BRIDGE_TEST_SAMPLER_H__
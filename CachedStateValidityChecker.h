@@ -0,0 +1,369 @@
+#ifndef __CACHED_STATE_VALIDITY_CHECKER_H__
+#define __CACHED_STATE_VALIDITY_CHECKER_H__
+
+#include "BatchValidity.h"
+#include "OmplConcepts.h"
+#include "SampleBatch.h"
+#include "SpaceHandle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//
+// Memoizes another validity checker's results, for planners that check
+// the same or nearly the same states again and again (shared edge
+// endpoints, repeated interpolation points).  It is a validity checker
+// itself, so it can be used wherever ValidatorType is, e.g. as
+// SimpleDiscreteMotionValidator<CachedStateValidityChecker<Checker>>.
+//
+// States are keyed by their binary serialization (the space must be an
+// OmplSerializableSpace), read as doubles (as every space's format is)
+// and quantized to cells of width resolution, so states that differ by
+// less than the resolution usually share a result.  The 64-bit hash of
+// the cell coordinates is the key; two cells with the same hash would
+// share a result, which for any realistic number of entries is
+// vanishingly unlikely.
+//
+// The table is set-associative: a key maps to one bucket of
+// kBucketSlots slots that fills one cache line, and a full bucket
+// evicts with the CLOCK algorithm (a slot hit since the hand last
+// passed is skipped once).  The number of buckets is the largest power
+// of two whose table fits in maxBytes.
+//
+// Lookups update the table, so one cache must not be used from several
+// threads at once.  Copies share the wrapped checker's configuration
+// but start with an empty table.
+//
+template <typename ValidatorType>
+class CachedStateValidityChecker
+{
+public:
+  typedef typename ValidatorType::SpaceType SpaceType;
+  typedef typename ValidatorType::StateType StateType;
+
+  static_assert(OmplSerializableSpace<SpaceType>(), "cached states are keyed by their serialization");
+
+  static constexpr std::size_t kBucketSlots = 7;
+
+  CachedStateValidityChecker (const ValidatorType&   validator,
+                              SpaceHandle<SpaceType> spSpace,
+                              double                 resolution,
+                              std::size_t            maxBytes);
+  CachedStateValidityChecker (const ValidatorType& validator,
+                              const SpaceType&     space,
+                              double               resolution,
+                              std::size_t          maxBytes);
+  CachedStateValidityChecker (const CachedStateValidityChecker& orig);
+  CachedStateValidityChecker (CachedStateValidityChecker&& sink)                 = default;
+  CachedStateValidityChecker& operator= (const CachedStateValidityChecker& orig);
+  CachedStateValidityChecker& operator= (CachedStateValidityChecker&& sink)      = default;
+  ~CachedStateValidityChecker ()                                                 = default;
+
+  const ValidatorType& getValidator () const
+  { return _validator; }
+
+  double getResolution () const
+  { return _resolution; }
+
+  std::size_t getCapacity () const
+  { return _numBuckets*kBucketSlots; }
+
+  bool isValid (const StateType& state) const;
+
+  //
+  // See BatchValidity.h.  Cache misses are passed on in one
+  // isValidMany call per block of states when the wrapped checker
+  // supports it.
+  //
+  std::size_t isValidMany (const StateType* states,
+                           std::size_t      numStates,
+                           std::uint64_t*   outValidMask,
+                           bool             stopAtFirstInvalid = false) const;
+
+  struct Statistics
+  {
+    std::size_t numHits;
+    std::size_t numMisses;
+    std::size_t numEvictions;
+    std::size_t numEntries;
+  };
+
+  Statistics getStatistics () const
+  { return Statistics{_numHits, _numMisses, _numEvictions, _numEntries}; }
+
+  // Forget all results (but not the counters).
+  void clear ();
+
+private:
+  //
+  // One cache line: keys (0 marks an empty slot), per-slot flags and
+  // the CLOCK hand.
+  //
+  struct alignas(64) Bucket
+  {
+    std::uint64_t keys[kBucketSlots];
+    std::uint8_t  flags[kBucketSlots];
+    std::uint8_t  hand;
+  };
+  static_assert(sizeof(Bucket) == 64, "a bucket fills one cache line");
+
+  static constexpr std::uint8_t kValidFlag      = 1;
+  static constexpr std::uint8_t kReferencedFlag = 2;
+
+  // States passed on to the wrapped checker in one isValidMany call.
+  static constexpr std::size_t kBlockSize = 64;
+
+  std::uint64_t hashState (const StateType& state) const;
+
+  // Returns the slot holding key, or null.
+  std::uint8_t* find (std::uint64_t key) const;
+
+  void insert (std::uint64_t key, bool isValid) const;
+
+  ValidatorType          _validator;
+  SpaceHandle<SpaceType> _spSpace;
+  double                 _resolution;
+  std::size_t            _maxBytes;
+  std::size_t            _numBuckets;
+
+  mutable std::unique_ptr<Bucket[]>        _buckets;
+  mutable std::vector<unsigned char>       _serialized;
+  mutable Samplers::SampleBatch<SpaceType> _missStates;
+
+  mutable std::size_t _numHits      = 0;
+  mutable std::size_t _numMisses    = 0;
+  mutable std::size_t _numEvictions = 0;
+  mutable std::size_t _numEntries   = 0;
+};
+
+template <typename ValidatorType>
+CachedStateValidityChecker<ValidatorType>::CachedStateValidityChecker (const ValidatorType&   validator,
+                                                                       SpaceHandle<SpaceType> spSpace,
+                                                                       double                 resolution,
+                                                                       std::size_t            maxBytes)
+  : _validator{validator}
+  , _spSpace{std::move(spSpace)}
+  , _resolution{resolution}
+  , _maxBytes{maxBytes}
+  , _numBuckets{1}
+{
+  while (2*_numBuckets*sizeof(Bucket) <= maxBytes) {
+    _numBuckets *= 2;
+  }
+  _buckets.reset(new Bucket[_numBuckets]);
+  _serialized.resize(_spSpace->getSerializationSize());
+  clear();
+}
+
+template <typename ValidatorType>
+CachedStateValidityChecker<ValidatorType>::CachedStateValidityChecker (const ValidatorType& validator,
+                                                                       const SpaceType&     space,
+                                                                       double               resolution,
+                                                                       std::size_t          maxBytes)
+  : CachedStateValidityChecker{validator, makeSpaceHandle(space), resolution, maxBytes}
+{ }
+
+template <typename ValidatorType>
+CachedStateValidityChecker<ValidatorType>::CachedStateValidityChecker (const CachedStateValidityChecker& orig)
+  : CachedStateValidityChecker{orig._validator, orig._spSpace, orig._resolution, orig._maxBytes}
+{ }
+
+template <typename ValidatorType>
+CachedStateValidityChecker<ValidatorType>& CachedStateValidityChecker<ValidatorType>::operator= (const CachedStateValidityChecker& orig)
+{ return *this = CachedStateValidityChecker{orig}; }
+
+template <typename ValidatorType>
+bool CachedStateValidityChecker<ValidatorType>::isValid (const StateType& state) const
+{
+  const std::uint64_t key = hashState(state);
+  if (std::uint8_t* flags = find(key)) {
+    ++_numHits;
+    *flags |= kReferencedFlag;
+    return *flags & kValidFlag;
+  }
+
+  ++_numMisses;
+  const bool isValid = _validator.isValid(state);
+  insert(key, isValid);
+  return isValid;
+}
+
+template <typename ValidatorType>
+std::size_t CachedStateValidityChecker<ValidatorType>::isValidMany (const StateType* states,
+                                                                    std::size_t      numStates,
+                                                                    std::uint64_t*   outValidMask,
+                                                                    bool             stopAtFirstInvalid) const
+{
+  if (outValidMask != nullptr) {
+    clearValidMask(outValidMask, numStates);
+  }
+  _missStates.allocate(*_spSpace, kBlockSize);
+
+  std::size_t numValid = 0;
+  for (std::size_t begin = 0; begin < numStates; begin += kBlockSize) {
+    const std::size_t count = std::min(kBlockSize, numStates - begin);
+
+    //
+    // Look the block up, stopping at a cached invalid state if asked
+    // to (nothing after it matters), and gather the misses.
+    //
+    std::uint64_t keys[kBlockSize];
+    std::uint64_t cachedValidMask = 0;
+    std::uint64_t missMask        = 0;
+    std::size_t   numChecked      = count;
+    std::size_t   numMisses       = 0;
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      keys[idx] = hashState(states[begin + idx]);
+      if (std::uint8_t* flags = find(keys[idx])) {
+        ++_numHits;
+        *flags |= kReferencedFlag;
+        if (*flags & kValidFlag) {
+          cachedValidMask |= std::uint64_t{1} << idx;
+        }
+        else if (stopAtFirstInvalid) {
+          numChecked = idx + 1;
+          break;
+        }
+      }
+      else {
+        missMask |= std::uint64_t{1} << idx;
+        _missStates[numMisses++] = states[begin + idx];
+      }
+    }
+
+    //
+    // Check the misses.  With early exit, the checker stops at the
+    // first invalid miss and the misses after it stay unknown (and
+    // uncached); they come after an invalid state anyway.
+    //
+    std::uint64_t missValidMask = 0;
+    const std::size_t numMissValid = ::isValidMany(_validator, _missStates.data(), numMisses, &missValidMask, stopAtFirstInvalid);
+    const std::size_t numMissesKnown = stopAtFirstInvalid ? std::min(numMissValid + 1, numMisses) : numMisses;
+    _numMisses += numMissesKnown;
+
+    std::size_t missIdx = 0;
+    for (std::size_t idx = 0; idx < numChecked; ++idx) {
+      bool isValid;
+      if (missMask >> idx & 1) {
+        if (missIdx >= numMissesKnown) {
+          break;
+        }
+        isValid = isValidMaskBitSet(&missValidMask, missIdx);
+        insert(keys[idx], isValid);
+        ++missIdx;
+      }
+      else {
+        isValid = cachedValidMask >> idx & 1;
+      }
+
+      if (isValid) {
+        ++numValid;
+        if (outValidMask != nullptr) {
+          outValidMask[(begin + idx)/64] |= std::uint64_t{1} << ((begin + idx)%64);
+        }
+      }
+      else if (stopAtFirstInvalid) {
+        return numValid;
+      }
+    }
+  }
+
+  return numValid;
+}
+
+template <typename ValidatorType>
+void CachedStateValidityChecker<ValidatorType>::clear ()
+{
+  std::memset(_buckets.get(), 0, _numBuckets*sizeof(Bucket));
+  _numEntries = 0;
+}
+
+//
+// Hash of the state's quantized coordinates (a splitmix64 step per
+// coordinate).  Coordinates too large to quantize, and any trailing
+// bytes, are hashed as raw bits.
+//
+template <typename ValidatorType>
+std::uint64_t CachedStateValidityChecker<ValidatorType>::hashState (const StateType& state) const
+{
+  _spSpace->serialize(state, _serialized.data());
+
+  auto mix = [](std::uint64_t hash, std::uint64_t value) {
+    hash += value + 0x9E3779B97F4A7C15ULL;
+    hash  = (hash ^ (hash >> 30))*0xBF58476D1CE4E5B9ULL;
+    hash  = (hash ^ (hash >> 27))*0x94D049BB133111EBULL;
+    return hash ^ (hash >> 31);
+  };
+
+  const double invResolution = 1.0/_resolution;
+  std::uint64_t hash = 0;
+  std::size_t offset = 0;
+  for (; offset + sizeof(double) <= _serialized.size(); offset += sizeof(double)) {
+    double value;
+    std::memcpy(&value, _serialized.data() + offset, sizeof(value));
+    const double cell = std::floor(value*invResolution);
+    std::uint64_t bits;
+    if (std::fabs(cell) < 0x1.0p62) {
+      bits = static_cast<std::uint64_t>(static_cast<std::int64_t>(cell));
+    }
+    else {
+      std::memcpy(&bits, &value, sizeof(bits));
+    }
+    hash = mix(hash, bits);
+  }
+  for (; offset < _serialized.size(); ++offset) {
+    hash = mix(hash, _serialized[offset]);
+  }
+
+  // 0 marks empty slots.
+  return hash != 0 ? hash : 1;
+}
+
+template <typename ValidatorType>
+std::uint8_t* CachedStateValidityChecker<ValidatorType>::find (std::uint64_t key) const
+{
+  Bucket& bucket = _buckets[key & (_numBuckets - 1)];
+  for (std::size_t slot = 0; slot < kBucketSlots; ++slot) {
+    if (bucket.keys[slot] == key) {
+      return &bucket.flags[slot];
+    }
+  }
+  return nullptr;
+}
+
+template <typename ValidatorType>
+void CachedStateValidityChecker<ValidatorType>::insert (std::uint64_t key, bool isValid) const
+{
+  Bucket& bucket = _buckets[key & (_numBuckets - 1)];
+
+  std::size_t slot = 0;
+  while (slot < kBucketSlots && bucket.keys[slot] != 0) {
+    ++slot;
+  }
+
+  if (slot < kBucketSlots) {
+    ++_numEntries;
+  }
+  else {
+    // Bucket full: advance the hand, giving referenced slots a
+    // second chance, until it reaches an unreferenced one.
+    while (bucket.flags[bucket.hand] & kReferencedFlag) {
+      bucket.flags[bucket.hand] &= ~kReferencedFlag;
+      bucket.hand = (bucket.hand + 1) % kBucketSlots;
+    }
+    slot        = bucket.hand;
+    bucket.hand = (bucket.hand + 1) % kBucketSlots;
+    ++_numEvictions;
+  }
+
+  bucket.keys[slot]  = key;
+  bucket.flags[slot] = isValid ? kValidFlag : 0;
+}
+
+#endif // __CACHED_STATE_VALIDITY_CHECKER_H__
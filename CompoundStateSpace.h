@@ -1,12 +1,22 @@
 #ifndef __COMPOUND_STATE_SPACE_H__
 #define __COMPOUND_STATE_SPACE_H__
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 #include <vector>
-#include <any>
 
+#include "AlignedAllocator.h"
 #include "OmplConcepts.h"
+#include "RandomNumberGenerator.h"
+#include "SpaceHandle.h"
 
 using namespace std;
 
@@ -20,6 +30,160 @@ namespace spaces
   {
     using namespace std;
 
+    //////////
+    //
+    // LAYOUT
+    //
+    //////////
+
+    //
+    // Where each substate lives inside a State's buffer, and how to
+    // copy, move, destroy and draw it without knowing its type.
+    //
+    // Layouts are built by Space::addSubspace and are immutable
+    // afterwards, so every State made by a Space shares the Space's
+    // layout through a shared_ptr<const Layout>.
+    //
+    // Slots are always flat: a nested compound contributes its leaf
+    // substates directly.  The nesting survives only in the structure
+    // tree, which is used for drawing and for access by path.
+    //
+    class Layout
+    {
+    public:
+      //
+      // Every buffer is allocated with this alignment, which bounds
+      // the alignment any substate type may require.
+      //
+      static constexpr size_t kAlignment = 64;
+
+      typedef AlignedAllocator<unsigned char, kAlignment> Allocator;
+
+      struct Slot {
+        size_t           offset;
+        size_t           size;
+        size_t           alignment;
+        const type_info* type;
+        bool             isTrivial;
+
+        void (*copyConstruct) (void* dst, const void* src);
+        void (*moveConstruct) (void* dst, void* src);
+        void (*copyAssign)    (void* dst, const void* src);
+        bool (*equals)        (const void* lhs, const void* rhs);
+        void (*destroy)       (void* obj);
+        void (*drawSubstate)  (const void* obj, ostream& ostr, size_t indent);
+      };
+
+      //
+      // A node of the structure tree is either a leaf, naming a slot,
+      // or a group of child nodes (a compound).  The root is a group.
+      //
+      struct Node {
+        bool isLeaf () const
+        { return slotIdx != kNoSlot; }
+
+        static constexpr size_t kNoSlot = ~size_t{0};
+
+        size_t       slotIdx = kNoSlot;
+        vector<Node> children;
+      };
+
+      //
+      // Returns a copy of this layout with a slot for SubstateType
+      // appended as a leaf of the root.  Existing slots keep their
+      // offsets.
+      //
+      template <OmplState SubstateType>
+      shared_ptr<const Layout> append () const
+      {
+        static_assert(alignof(SubstateType) <= kAlignment, "substate alignment exceeds Layout::kAlignment");
+
+        Slot slot;
+        slot.size          = sizeof(SubstateType);
+        slot.alignment     = alignof(SubstateType);
+        slot.type          = &typeid(SubstateType);
+        slot.isTrivial     = is_trivially_copyable<SubstateType>::value && is_trivially_destructible<SubstateType>::value;
+        slot.copyConstruct = [](void* dst, const void* src) { new (dst) SubstateType(*static_cast<const SubstateType*>(src)); };
+        slot.moveConstruct = [](void* dst, void* src)       { new (dst) SubstateType(move(*static_cast<SubstateType*>(src))); };
+        slot.copyAssign    = [](void* dst, const void* src) { *static_cast<SubstateType*>(dst) = *static_cast<const SubstateType*>(src); };
+        slot.equals        = [](const void* lhs, const void* rhs) { return *static_cast<const SubstateType*>(lhs) == *static_cast<const SubstateType*>(rhs); };
+        slot.destroy       = [](void* obj)                  { static_cast<SubstateType*>(obj)->~SubstateType(); };
+        slot.drawSubstate  = [](const void* obj, ostream& ostr, size_t indent) { draw(*static_cast<const SubstateType*>(obj), ostr, indent); };
+
+        auto spLayout = make_shared<Layout>(*this);
+        Node leaf;
+        leaf.slotIdx = spLayout->appendSlot(slot);
+        spLayout->root.children.push_back(leaf);
+        return spLayout;
+      }
+
+      //
+      // Returns a copy of this layout with all of other's slots
+      // appended, and other's structure added as a group under the
+      // root.  Existing slots keep their offsets.
+      //
+      shared_ptr<const Layout> appendGroup (const Layout& other) const
+      {
+        auto spLayout = make_shared<Layout>(*this);
+        const size_t firstSlotIdx = spLayout->slots.size();
+        for (const auto& slot : other.slots) {
+          spLayout->appendSlot(slot);
+        }
+        Node group = other.root;
+        shiftSlots(group, firstSlotIdx);
+        spLayout->root.children.push_back(move(group));
+        return spLayout;
+      }
+
+      //
+      // Follows path (child indices from the root) to a leaf and
+      // returns its slot index.  Throws out_of_range if the path does
+      // not end at a leaf.
+      //
+      size_t slotIndex (initializer_list<size_t> path) const
+      {
+        const Node* node = &root;
+        for (size_t childIdx : path) {
+          if (node->isLeaf() || childIdx >= node->children.size()) {
+            throw out_of_range{"Compound::Layout: invalid substate path"};
+          }
+          node = &node->children[childIdx];
+        }
+        if (!node->isLeaf()) {
+          throw out_of_range{"Compound::Layout: path names a compound, not a substate"};
+        }
+        return node->slotIdx;
+      }
+
+      vector<Slot> slots;
+      Node         root;
+      size_t       size      = 0;
+      bool         isTrivial = true;
+
+    private:
+      size_t appendSlot (Slot slot)
+      {
+        slot.offset = (size + slot.alignment - 1) / slot.alignment * slot.alignment;
+        size        = slot.offset + slot.size;
+        isTrivial   = isTrivial && slot.isTrivial;
+        slots.push_back(slot);
+        return slots.size() - 1;
+      }
+
+      static void shiftSlots (Node& node, size_t firstSlotIdx)
+      {
+        if (node.isLeaf()) {
+          node.slotIdx += firstSlotIdx;
+        }
+        for (auto& child : node.children) {
+          shiftSlots(child, firstSlotIdx);
+        }
+      }
+    };
+
+    inline bool operator== (const Layout::Node& lhs, const Layout::Node& rhs)
+    { return lhs.slotIdx == rhs.slotIdx && lhs.children == rhs.children; }
+
     //////////
     //
     // STATE
@@ -27,188 +191,528 @@ namespace spaces
     //////////
 
     class Space;
+    class Arena;
 
+    //
+    // All substates live in a single aligned buffer, at the offsets
+    // given by the shared layout.  Copying a state is one allocation
+    // plus a memcpy when every substate is trivially copyable, and
+    // assigning between states with the same layout allocates nothing.
+    //
+    // States handed out by an Arena do not own their buffer; it
+    // belongs to the arena.
+    //
     class State
     {
       friend class Space;
+      friend class Arena;
 
     public:
       typedef State StateType;
 
-    private:
-      class Substate
+      State ()
       {
-      public:
-        //
-        // StateType --> Substate conversion.
-        //
-        // Wrap the given StateType object in a ConcreteWrapper.  Use move semantics
-        // to avoid unnecessary copies and potential exceptions.
-        //
-        template <OmplState StateType>
-        Substate (StateType sink)
-          : _upSubstateConcept{make_unique<ConcreteWrapper<StateType>>(move(sink))}
-        {
-          // cout << "Substate ctor" << endl;
-        }
+        // cout << "State ctor" << endl;
+      }
 
-        //
-        // Copy ctor.
-        //
-        // Ensure that copies are equal and disjoint.
-        //
-        Substate (const Substate& orig)
-          : _upSubstateConcept{orig._upSubstateConcept->copy()}
-        {
-          // cout << "Substate copy ctor" << endl;
+      //
+      // Copy ctor.
+      //
+      // Ensure that copies are equal and disjoint.
+      //
+      State (const State& orig)
+        : _spLayout{orig._spLayout}
+      {
+        allocate();
+        constructSubstates(orig);
+      }
+
+      //
+      // Move ctor.
+      //
+      // Steal the buffer of the incoming sink object.  An arena's
+      // buffer cannot be stolen, so pooled states are copied instead.
+      // That copy can throw (bad_alloc, or a substate's copy), which
+      // terminates: the move stays noexcept so that containers of
+      // states move them rather than copy them.
+      //
+      State (State&& sink) noexcept
+        : _spLayout{sink._spLayout}
+      {
+        // cout << "State move ctor" << endl;
+        if (!sink._ownsData) {
+          allocate();
+          constructSubstates(sink);
+          return;
         }
+        _data      = sink._data;
+        sink._data = nullptr;
+        sink._spLayout.reset();
+      }
 
-        //
-        // Move ctor.
-        //
-        // Steal the guts of the incoming sink object.
-        //
-        Substate (Substate&& sink) noexcept
-          : _upSubstateConcept{move(sink._upSubstateConcept)}
-        {
-          // cout << "Substate move ctor" << endl;
+      //
+      // Assignment operator.
+      //
+      // States sharing a layout are assigned substate by substate in
+      // place.  Otherwise make a copy and use the move assignment
+      // operator (below) to ensure strong exception guarantee.
+      //
+      State& operator= (const State& orig)
+      {
+        // cout << "State assignment" << endl;
+        if (this == &orig) {
+          return *this;
         }
+        if (_spLayout != orig._spLayout) {
+          State copy{orig};
+          release();
+          _spLayout  = move(copy._spLayout);
+          _data      = copy._data;
+          _ownsData  = true;
+          copy._data = nullptr;
+          return *this;
+        }
+        if (!_spLayout || _spLayout->isTrivial) {
+          copyBytes(orig);
+          return *this;
+        }
+        for (const auto& slot : _spLayout->slots) {
+          slot.copyAssign(_data + slot.offset, orig._data + slot.offset);
+        }
+        return *this;
+      }
 
-        //
-        // Assignment operator.
-        //
-        // Create a copy of the original object, and then
-        // use the move assignment operator (below) to
-        // ensure strong exception gurantee.
-        //
-        Substate& operator= (const Substate& orig)
-        {
-          // cout << "Substate assignment" << endl;
-          return *this = Substate{orig};
+      State& operator= (State&& sink)
+      {
+        // cout << "State move assignment" << endl;
+        if (!_ownsData || !sink._ownsData) {
+          return *this = static_cast<const State&>(sink);
         }
+        swap(_spLayout, sink._spLayout);
+        swap(_data,     sink._data);
+        return *this;
+      }
 
-        //
-        // Move assignment operator.
-        //
-        // Steal the guts of the incoming sink object.
-        //
-        Substate& operator= (Substate&& sink) noexcept
-        {
-          // cout << "Substate move assignment" << endl;
-          _upSubstateConcept = move(sink._upSubstateConcept);
-          return *this;
+      ~State ()
+      {
+        // cout << "State dtor" << endl;
+        release();
+      }
+
+      //
+      // Appends a substate, giving this state a new layout.  Spaces do
+      // this once per subspace on their prototype state; states made
+      // from a space should not be extended.
+      //
+      template <OmplState SubstateType>
+      void addSubstate (SubstateType sink)
+      {
+        State newState = grow(_spLayout ? _spLayout->append<SubstateType>()
+                                        : Layout{}.append<SubstateType>());
+        const auto& newSlot = newState._spLayout->slots.back();
+        try {
+          new (newState._data + newSlot.offset) SubstateType(move(sink));
+        }
+        catch (...) {
+          newState.abandon(newState._spLayout->slots.size() - 1);
+          throw;
         }
 
-        //
-        // Destructor.  Default will do.
-        //
-        ~Substate ()
-        {
-          // cout << "Substate dtor" << endl;
+        *this = move(newState);
+      }
+
+      //
+      // Appends copies of all of other's substates, flattened, as one
+      // nested group.  other may be *this.
+      //
+      void addSubstates (const State& other)
+      {
+        if (&other == this) {
+          addSubstates(State{other});
+          return;
         }
 
-        friend void draw (const Substate& substate, ostream& ostr, size_t indent)
-        { substate._upSubstateConcept->_draw(ostr, indent); }
+        const Layout emptyLayout;
+        const Layout& otherLayout = other._spLayout ? *other._spLayout : emptyLayout;
+        State newState = grow(_spLayout ? _spLayout->appendGroup(otherLayout)
+                                        : Layout{}.appendGroup(otherLayout));
+        const size_t firstSlotIdx = newState._spLayout->slots.size() - otherLayout.slots.size();
+        size_t       idx          = 0;
+        try {
+          for (; idx < otherLayout.slots.size(); ++idx) {
+            const auto& newSlot = newState._spLayout->slots[firstSlotIdx + idx];
+            newSlot.copyConstruct(newState._data + newSlot.offset, other.substateData(idx));
+          }
+        }
+        catch (...) {
+          newState.abandon(firstSlotIdx + idx);
+          throw;
+        }
 
-        //
-        // These return std::any because there needs to be a
-        // way to polymorphically get the contained State to
-        // the Space that will be manipulating it (after a
-        // downcast, which will throw at runtime if the
-        // State and Space are not compatible).
-        //
+        *this = move(newState);
+      }
 
-        const any& anyOfState () const
-        { return _upSubstateConcept->anyOfState(); }
+      //
+      // The number of leaf substates, counting those of nested
+      // compounds individually.
+      //
+      size_t getNumSubstates () const
+      { return _spLayout ? _spLayout->slots.size() : 0; }
+
+      //
+      // Typed access to a substate, by flat (leaf) index or by path
+      // through the nesting, e.g. {3, 1} for the second substate of
+      // the fourth entry.  Throws bad_cast if the substate is not a
+      // SubstateType.
+      //
+      template <OmplState SubstateType>
+      const SubstateType& getSubstate (size_t idx) const
+      {
+        if (*_spLayout->slots[idx].type != typeid(SubstateType)) {
+          throw bad_cast{};
+        }
+        return *static_cast<const SubstateType*>(substateData(idx));
+      }
 
-        any& anyOfState ()
-        { return _upSubstateConcept->anyOfState(); }
+      template <OmplState SubstateType>
+      SubstateType& getSubstate (size_t idx)
+      { return const_cast<SubstateType&>(static_cast<const State&>(*this).getSubstate<SubstateType>(idx)); }
 
-      private:
-        struct SubstateConcept {
-          virtual ~SubstateConcept () = default;
-          virtual unique_ptr<SubstateConcept> copy () const = 0;
-          virtual const any& anyOfState () const = 0;
-          virtual       any& anyOfState ()       = 0;
+      template <OmplState SubstateType>
+      const SubstateType& getSubstate (initializer_list<size_t> path) const
+      { return getSubstate<SubstateType>(_spLayout->slotIndex(path)); }
 
-          virtual void _draw (ostream& ostr, size_t indent) const = 0;
-        };
+      template <OmplState SubstateType>
+      SubstateType& getSubstate (initializer_list<size_t> path)
+      { return getSubstate<SubstateType>(_spLayout->slotIndex(path)); }
 
-        template <OmplState StateType>
-        struct ConcreteWrapper final : public SubstateConcept {
-          ConcreteWrapper (StateType state)
-            : _anyOfState{move(state)}
-          { }
+      //
+      // States are equal when they have the same structure and
+      // equal substates.
+      //
+      friend bool operator== (const State& lhs, const State& rhs)
+      {
+        if (lhs.getNumSubstates() != rhs.getNumSubstates()) {
+          return false;
+        }
+        if (lhs.getNumSubstates() == 0) {
+          return true;
+        }
+        if (lhs._spLayout != rhs._spLayout && !(lhs._spLayout->root == rhs._spLayout->root)) {
+          return false;
+        }
+        for (size_t idx = 0; idx < lhs.getNumSubstates(); ++idx) {
+          const auto& slot = lhs._spLayout->slots[idx];
+          if (*slot.type != *rhs._spLayout->slots[idx].type ||
+              !slot.equals(lhs.substateData(idx), rhs.substateData(idx))) {
+            return false;
+          }
+        }
+        return true;
+      }
 
-          unique_ptr<SubstateConcept> copy () const override
-          { return make_unique<ConcreteWrapper>(*this); }
+      friend bool operator!= (const State& lhs, const State& rhs)
+      { return !(lhs == rhs); }
 
-          const any& anyOfState () const override
-          { return _anyOfState; }
+      friend void draw (const State& state, ostream& ostr, size_t indent)
+      {
+        if (!state._spLayout) {
+          ostr << string(indent, ' ') << "begin compound state" << endl;
+          ostr << string(indent, ' ') << "end compound state" << endl;
+          return;
+        }
+        state.drawNode(state._spLayout->root, ostr, indent);
+      }
 
-          any& anyOfState () override
-          { return _anyOfState; }
+    private:
+      void drawNode (const Layout::Node& node, ostream& ostr, size_t indent) const
+      {
+        if (node.isLeaf()) {
+          _spLayout->slots[node.slotIdx].drawSubstate(substateData(node.slotIdx), ostr, indent);
+          return;
+        }
+        ostr << string(indent, ' ') << "begin compound state" << endl;
+        for (const auto& child : node.children) {
+          drawNode(child, ostr, indent + 2);
+        }
+        ostr << string(indent, ' ') << "end compound state" << endl;
+      }
 
-          void _draw (ostream& ostr, size_t indent) const override
-          { draw(any_cast<const StateType&>(_anyOfState), ostr, indent); }
+      //
+      // Returns a state with newLayout, which must extend this state's
+      // layout, holding this state's substates (moved) and leaving the
+      // new slots unconstructed.
+      //
+      State grow (shared_ptr<const Layout> spNewLayout)
+      {
+        State newState;
+        newState._spLayout = move(spNewLayout);
+        newState.allocate();
+        if (_spLayout) {
+          size_t numConstructed = 0;
+          try {
+            for (const auto& slot : _spLayout->slots) {
+              slot.moveConstruct(newState._data + slot.offset, _data + slot.offset);
+              ++numConstructed;
+            }
+          }
+          catch (...) {
+            newState.abandon(numConstructed);
+            throw;
+          }
+        }
+        return newState;
+      }
 
-          any _anyOfState;
-        };
+      //
+      // Arena-backed state: the substates in data are constructed by
+      // the arena, and the buffer is never freed by the state.
+      //
+      State (shared_ptr<const Layout> spLayout, unsigned char* data)
+        : _spLayout{move(spLayout)}
+        , _data{data}
+        , _ownsData{false}
+      { }
+
+      //
+      // Substate access is a fixed offset into the buffer.
+      //
+      const void* substateData (size_t idx) const
+      { return _data + _spLayout->slots[idx].offset; }
+
+      void* substateData (size_t idx)
+      { return _data + _spLayout->slots[idx].offset; }
+
+      //
+      // Allocates (but does not construct) a buffer for _spLayout.
+      //
+      void allocate ()
+      {
+        if (_spLayout && _spLayout->size > 0) {
+          _data = Layout::Allocator{}.allocate(_spLayout->size);
+        }
+      }
 
-        unique_ptr<SubstateConcept> _upSubstateConcept;
-      };
+      //
+      // Copy-constructs orig's substates into this state's (allocated
+      // but unconstructed) buffer; orig must have the same layout.  If
+      // a copy throws, this state is abandoned (see below).
+      //
+      void constructSubstates (const State& orig)
+      {
+        if (!_spLayout || _spLayout->isTrivial) {
+          copyBytes(orig);
+          return;
+        }
+        size_t numConstructed = 0;
+        try {
+          for (const auto& slot : _spLayout->slots) {
+            slot.copyConstruct(_data + slot.offset, orig._data + slot.offset);
+            ++numConstructed;
+          }
+        }
+        catch (...) {
+          abandon(numConstructed);
+          throw;
+        }
+      }
 
-    public:
-      State ()
+      //
+      // Undoes a construction that threw part way: destroys the first
+      // numConstructed substates, frees the buffer if this state owns
+      // it and leaves the state without one, so its destructor does
+      // nothing more.
+      //
+      void abandon (size_t numConstructed) noexcept
       {
-        // cout << "State ctor" << endl;
+        for (size_t idx = 0; idx < numConstructed; ++idx) {
+          const auto& slot = _spLayout->slots[idx];
+          slot.destroy(_data + slot.offset);
+        }
+        if (_data && _ownsData) {
+          Layout::Allocator{}.deallocate(_data, _spLayout->size);
+        }
+        _data = nullptr;
       }
 
-      State (const State& orig)
-        : _substates{orig._substates}
+      void copyBytes (const State& orig)
       {
-        // cout << "State copy ctor" << endl;
+        if (_data) {
+          memcpy(_data, orig._data, _spLayout->size);
+        }
       }
 
-      State (State&& sink) noexcept
-        : _substates{move(sink._substates)}
+      void release ()
       {
-        // cout << "State move ctor" << endl;
+        if (!_data) {
+          return;
+        }
+        if (!_spLayout->isTrivial) {
+          for (const auto& slot : _spLayout->slots) {
+            slot.destroy(_data + slot.offset);
+          }
+        }
+        if (_ownsData) {
+          Layout::Allocator{}.deallocate(_data, _spLayout->size);
+        }
+        _data = nullptr;
       }
 
-      State& operator= (const State& orig)
+      shared_ptr<const Layout> _spLayout;
+      unsigned char*           _data     = nullptr;
+      bool                     _ownsData = true;
+    };
+
+    //////////
+    //
+    // ARENA
+    //
+    //////////
+
+    //
+    // Recycles storage for states of one layout.  Each slot holds a
+    // State followed by its buffer, so a pooled state is a single
+    // cache-line-aligned chunk.  Slots are carved from large blocks;
+    // freed slots go on a free list, and reset() recycles every slot
+    // at once without returning memory to the system.
+    //
+    // An arena is made from a space and owned by whoever allocates from
+    // it, e.g. one per planner thread or per query, so the space itself
+    // stays immutable and shareable.  It keeps the layout it was made
+    // with, so its states stay valid until they are freed, reset or the
+    // arena is destroyed, whatever happens to the space (though they no
+    // longer match a space that has since had subspaces added).
+    //
+    // Not thread-safe: use one arena per thread.
+    //
+    class Arena
+    {
+    public:
+      static constexpr size_t kSlotsPerBlock = 256;
+
+      // States initialized like space.makeState().
+      explicit Arena (const Space& space);
+
+      // States initialized as copies of protoState.
+      explicit Arena (const State& protoState)
+        : _protoState{protoState}
+        , _bufferOffset{roundUp(sizeof(SlotHeader) + sizeof(State))}
+        , _slotSize{_bufferOffset + roundUp(protoState._spLayout ? protoState._spLayout->size : 0)}
+      { }
+
+      Arena (const Arena& orig)            = delete;
+      Arena& operator= (const Arena& orig) = delete;
+
+      ~Arena ()
       {
-        // cout << "State assignment" << endl;
-        return *this = State{orig};
+        reset();
+        for (auto* block : _blocks) {
+          Layout::Allocator{}.deallocate(block, kSlotsPerBlock*_slotSize);
+        }
       }
 
-      State& operator= (State&& sink)
+      //
+      // Returns a state initialized as a copy of the prototype.
+      //
+      State* allocState ()
       {
-        // cout << "State move assignment" << endl;
-        _substates = move(sink._substates);
-        return *this;
+        SlotHeader* header = _freeList;
+        if (header) {
+          _freeList = header->nextFree;
+        }
+        else {
+          if (_blocks.empty() || _numSlotsUsed == kSlotsPerBlock) {
+            nextBlock();
+          }
+          header = reinterpret_cast<SlotHeader*>(_blocks[_curBlock] + _numSlotsUsed*_slotSize);
+          ++_numSlotsUsed;
+        }
+
+        unsigned char* slot  = reinterpret_cast<unsigned char*>(header);
+        State*         state = new (slot + sizeof(SlotHeader)) State{_protoState._spLayout, slot + _bufferOffset};
+        try {
+          state->constructSubstates(_protoState);
+        }
+        catch (...) {
+          state->~State();
+          header->isLive   = false;
+          header->nextFree = _freeList;
+          _freeList        = header;
+          throw;
+        }
+        header->isLive = true;
+        return state;
       }
 
-      ~State ()
+      vector<State*> allocStates (size_t numStates)
       {
-        // cout << "State dtor" << endl;
+        vector<State*> states(numStates);
+        for (auto& state : states) {
+          state = allocState();
+        }
+        return states;
       }
 
-      template <OmplState StateType>
-      void addSubstate (StateType&& sink)
-      { _substates.emplace_back(std::forward<StateType>(sink)); }
+      void freeState (State* state)
+      {
+        SlotHeader* header = reinterpret_cast<SlotHeader*>(reinterpret_cast<unsigned char*>(state) - sizeof(SlotHeader));
+        state->~State();
+        header->isLive   = false;
+        header->nextFree = _freeList;
+        _freeList        = header;
+      }
 
-      friend void draw (const State& state, ostream& ostr, size_t indent)
+      //
+      // Destroys every live state and makes all slots available again.
+      // Pointers previously returned by allocState become invalid.
+      //
+      void reset ()
       {
-        ostr << string(indent, ' ') << "begin compound state" << endl;
-        for (const auto& substate : state._substates) {
-          draw(substate, ostr, indent + 2);
+        for (size_t blockIdx = 0; blockIdx < _blocks.size() && blockIdx <= _curBlock; ++blockIdx) {
+          const size_t numSlots = (blockIdx == _curBlock) ? _numSlotsUsed : kSlotsPerBlock;
+          for (size_t slotIdx = 0; slotIdx < numSlots; ++slotIdx) {
+            SlotHeader* header = reinterpret_cast<SlotHeader*>(_blocks[blockIdx] + slotIdx*_slotSize);
+            if (header->isLive) {
+              reinterpret_cast<State*>(header + 1)->~State();
+              header->isLive = false;
+            }
+          }
         }
-        cout << string(indent, ' ') << "end compound state" << endl;
+        _freeList     = nullptr;
+        _curBlock     = 0;
+        _numSlotsUsed = 0;
       }
 
     private:
-      vector<Substate> _substates;
+      struct SlotHeader {
+        SlotHeader* nextFree;
+        bool        isLive;
+      };
+
+      static size_t roundUp (size_t numBytes)
+      { return (numBytes + Layout::kAlignment - 1) / Layout::kAlignment * Layout::kAlignment; }
+
+      //
+      // Moves on to the next block, reusing blocks kept by reset().
+      //
+      void nextBlock ()
+      {
+        if (!_blocks.empty()) {
+          ++_curBlock;
+        }
+        if (_curBlock == _blocks.size()) {
+          _blocks.push_back(Layout::Allocator{}.allocate(kSlotsPerBlock*_slotSize));
+        }
+        _numSlotsUsed = 0;
+      }
+
+      State                  _protoState;
+      size_t                 _bufferOffset;
+      size_t                 _slotSize;
+      vector<unsigned char*> _blocks;
+      size_t                 _curBlock     = 0;
+      size_t                 _numSlotsUsed = 0;
+      SlotHeader*            _freeList     = nullptr;
     };
 
     //////////
@@ -231,18 +735,28 @@ namespace spaces
         //
         template <OmplSpace SpaceType>
         Subspace (SpaceType sink)
-          : _upSubspaceConcept{make_unique<ConcreteWrapper<SpaceType>>(move(sink))}
+          : Subspace{makeSpaceHandle(move(sink))}
         {
           // cout << "Subspace ctor" << endl;
         }
 
+        //
+        // SpaceHandle --> Subspace conversion.
+        //
+        // Refer to the shared space rather than copying it.
+        //
+        template <OmplSpace SpaceType>
+        Subspace (SpaceHandle<SpaceType> spSpace)
+          : _spSubspaceConcept{make_shared<const ConcreteWrapper<SpaceType>>(move(spSpace))}
+        { }
+
         //
         // Copy ctor.
         //
-        // Ensure that copies are equal and disjoint.
+        // The wrapped space is immutable, so copies share it.
         //
         Subspace (const Subspace& orig)
-          : _upSubspaceConcept{orig._upSubspaceConcept->copy()}
+          : _spSubspaceConcept{orig._spSubspaceConcept}
         {
           // cout << "Subspace copy ctor" << endl;
         }
@@ -253,7 +767,7 @@ namespace spaces
         // Steal the guts of the incoming sink object.
         //
         Subspace (Subspace&& sink) noexcept
-          : _upSubspaceConcept{move(sink._upSubspaceConcept)}
+          : _spSubspaceConcept{move(sink._spSubspaceConcept)}
         {
           // cout << "Subspace move ctor" << endl;
         }
@@ -261,14 +775,13 @@ namespace spaces
         //
         // Assignment operator.
         //
-        // Create a copy of the original object, and then
-        // use the move assignment operator (below) to
-        // ensure strong exception gurantee.
+        // Share the original's space, as the copy ctor does.
         //
         Subspace& operator= (const Subspace& orig)
         {
           // cout << "Subspace assignment" << endl;
-          return *this = Subspace{orig};
+          _spSubspaceConcept = orig._spSubspaceConcept;
+          return *this;
         }
 
         //
@@ -279,7 +792,7 @@ namespace spaces
         Subspace& operator= (Subspace&& sink) noexcept
         {
           // cout << "Subspace move assignment" << endl;
-          _upSubspaceConcept = move(sink._upSubspaceConcept);
+          _spSubspaceConcept = move(sink._spSubspaceConcept);
           return *this;
         }
 
@@ -292,72 +805,308 @@ namespace spaces
         }
 
         friend void draw (const Subspace& subspace, ostream& ostr, size_t indent)
-        { subspace._upSubspaceConcept->_draw(ostr, indent); }
+        { subspace._spSubspaceConcept->_draw(ostr, indent); }
 
         int getDimension () const
-        { return _upSubspaceConcept->getDimension(); }
+        { return _spSubspaceConcept->getDimension(); }
+
+        //
+        // Substates are passed as untyped pointers into a State's
+        // buffer; the layout guarantees they point at this subspace's
+        // StateType.
+        //
+
+        void sampleUniform (void* outState, RandomNumberGenerator& rng) const
+        { _spSubspaceConcept->sampleUniform(outState, rng); }
+
+        void sampleUniformNear (const void* state, double distance, void* outState, RandomNumberGenerator& rng) const
+        { _spSubspaceConcept->sampleUniformNear(state, distance, outState, rng); }
+
+        void sampleGaussianNear (const void* state, double stddev, void* outState, RandomNumberGenerator& rng) const
+        { _spSubspaceConcept->sampleGaussianNear(state, stddev, outState, rng); }
+
+        void sampleFromUnitCube (const double* unitCoords, void* outState) const
+        { _spSubspaceConcept->sampleFromUnitCube(unitCoords, outState); }
 
-        void sampleUniform (State::Substate& outState) const
-        { _upSubspaceConcept->sampleUniform(outState); }
+        double distance (const void* fromState, const void* toState) const
+        { return _spSubspaceConcept->distance(fromState, toState); }
 
-        void sampleUniformNear (const State::Substate& state, double distance, State::Substate& outState) const
-        { _upSubspaceConcept->sampleUniformNear(state, distance, outState); }
+        void interpolate (const void* fromState, const void* toState, double tt, void* outState) const
+        { _spSubspaceConcept->interpolate(fromState, toState, tt, outState); }
 
-        void sampleGaussianNear (const State::Substate& state, double stddev, State::Substate& outState) const
-        { _upSubspaceConcept->sampleGaussianNear(state, stddev, outState); }
+        bool satisfiesBounds (const void* state) const
+        { return _spSubspaceConcept->satisfiesBounds(state); }
+
+        void enforceBounds (void* state) const
+        { _spSubspaceConcept->enforceBounds(state); }
+
+        double getMaximumExtent () const
+        { return _spSubspaceConcept->getMaximumExtent(); }
+
+        double getMeasure () const
+        { return _spSubspaceConcept->getMeasure(); }
+
+        //
+        // Column-wise batch operations: one virtual call covers this
+        // subspace's substates of many (at most kBlockSize) compound
+        // states.
+        //
+
+        void sampleUniformMany (void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const
+        { _spSubspaceConcept->sampleUniformMany(outStates, numStates, rng); }
+
+        void sampleUniformNearMany (const void* const* states, double distance, void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const
+        { _spSubspaceConcept->sampleUniformNearMany(states, distance, outStates, numStates, rng); }
+
+        void sampleGaussianNearMany (const void* const* states, double stddev, void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const
+        { _spSubspaceConcept->sampleGaussianNearMany(states, stddev, outStates, numStates, rng); }
+
+        void accumulateDistanceMany (const void* fromState, const void* const* toStates, size_t numStates, double weight, double* outDistances) const
+        { _spSubspaceConcept->accumulateDistanceMany(fromState, toStates, numStates, weight, outDistances); }
+
+        void interpolateMany (const void* const* fromStates, const void* const* toStates, size_t numStates, double tt, void* const* outStates) const
+        { _spSubspaceConcept->interpolateMany(fromStates, toStates, numStates, tt, outStates); }
+
+        //
+        // Binary serialization.  These throw logic_error if the space
+        // is not an OmplSerializableSpace.
+        //
+
+        void appendSchema (string& schema) const
+        { _spSubspaceConcept->appendSchema(schema); }
+
+        size_t getSerializationSize () const
+        { return _spSubspaceConcept->getSerializationSize(); }
+
+        void serialize (const void* state, unsigned char* outBytes) const
+        { _spSubspaceConcept->serialize(state, outBytes); }
+
+        void deserialize (const unsigned char* bytes, void* outState) const
+        { _spSubspaceConcept->deserialize(bytes, outState); }
 
       private:
         struct SubspaceConcept {
           virtual ~SubspaceConcept () = default;
-          virtual unique_ptr<SubspaceConcept> copy () const = 0;
           virtual void _draw (ostream& ostr, size_t indent) const = 0;
 
           virtual int getDimension () const = 0;
 
-          virtual void sampleUniform      (State::Substate& outState) const = 0;
-          virtual void sampleUniformNear  (const State::Substate& state, double distance, State::Substate& outState) const = 0;
-          virtual void sampleGaussianNear (const State::Substate& state, double stddev,   State::Substate& outState)   const = 0;
+          virtual void sampleUniform      (void* outState, RandomNumberGenerator& rng) const = 0;
+          virtual void sampleUniformNear  (const void* state, double distance, void* outState, RandomNumberGenerator& rng) const = 0;
+          virtual void sampleGaussianNear (const void* state, double stddev,   void* outState, RandomNumberGenerator& rng) const = 0;
+          virtual void sampleFromUnitCube (const double* unitCoords, void* outState) const = 0;
+
+          virtual double distance        (const void* fromState, const void* toState) const = 0;
+          virtual void   interpolate     (const void* fromState, const void* toState, double tt, void* outState) const = 0;
+          virtual bool   satisfiesBounds (const void* state) const = 0;
+          virtual void   enforceBounds   (void* state) const = 0;
+
+          virtual double getMaximumExtent () const = 0;
+          virtual double getMeasure       () const = 0;
+
+          virtual void sampleUniformMany      (void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const = 0;
+          virtual void sampleUniformNearMany  (const void* const* states, double distance, void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const = 0;
+          virtual void sampleGaussianNearMany (const void* const* states, double stddev,   void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const = 0;
+          virtual void accumulateDistanceMany (const void* fromState, const void* const* toStates, size_t numStates, double weight, double* outDistances) const = 0;
+          virtual void interpolateMany        (const void* const* fromStates, const void* const* toStates, size_t numStates, double tt, void* const* outStates) const = 0;
+
+          virtual void   appendSchema         (string& schema) const = 0;
+          virtual size_t getSerializationSize () const = 0;
+          virtual void   serialize            (const void* state, unsigned char* outBytes) const = 0;
+          virtual void   deserialize          (const unsigned char* bytes, void* outState) const = 0;
         };
 
         template <OmplSpace SpaceType>
         struct ConcreteWrapper final : public SubspaceConcept {
-          ConcreteWrapper (SpaceType space)
-            : _space(move(space))
+          ConcreteWrapper (SpaceHandle<SpaceType> spSpace)
+            : _spSpace(move(spSpace))
           { }
 
-          unique_ptr<SubspaceConcept> copy () const override
-          { return make_unique<ConcreteWrapper>(*this); }
-
           void _draw (ostream& ostr, size_t indent) const override
-          { draw(_space, ostr, indent); }
+          { draw(*_spSpace, ostr, indent); }
 
           int getDimension () const override
-          { return _space.getDimension(); }
+          { return _spSpace->getDimension(); }
+
+          typedef typename SpaceType::StateType SubstateType;
+
+          void sampleUniform (void* outState, RandomNumberGenerator& rng) const override
+          { _spSpace->sampleUniform(*static_cast<SubstateType*>(outState), rng); }
+
+          void sampleUniformNear (const void* state, double distance, void* outState, RandomNumberGenerator& rng) const override
+          { _spSpace->sampleUniformNear(*static_cast<const SubstateType*>(state), distance, *static_cast<SubstateType*>(outState), rng); }
+
+          void sampleGaussianNear (const void* state, double stddev, void* outState, RandomNumberGenerator& rng) const override
+          { _spSpace->sampleGaussianNear(*static_cast<const SubstateType*>(state), stddev, *static_cast<SubstateType*>(outState), rng); }
+
+          void sampleFromUnitCube (const double* unitCoords, void* outState) const override
+          { _spSpace->sampleFromUnitCube(unitCoords, *static_cast<SubstateType*>(outState)); }
+
+          double distance (const void* fromState, const void* toState) const override
+          { return _spSpace->distance(*static_cast<const SubstateType*>(fromState), *static_cast<const SubstateType*>(toState)); }
+
+          void interpolate (const void* fromState, const void* toState, double tt, void* outState) const override
+          {
+            _spSpace->interpolate(*static_cast<const SubstateType*>(fromState), *static_cast<const SubstateType*>(toState),
+                               tt, *static_cast<SubstateType*>(outState));
+          }
+
+          bool satisfiesBounds (const void* state) const override
+          { return _spSpace->satisfiesBounds(*static_cast<const SubstateType*>(state)); }
+
+          void enforceBounds (void* state) const override
+          { _spSpace->enforceBounds(*static_cast<SubstateType*>(state)); }
+
+          double getMaximumExtent () const override
+          { return _spSpace->getMaximumExtent(); }
+
+          double getMeasure () const override
+          { return _spSpace->getMeasure(); }
+
+          //
+          // The batch overrides use the space's pointer-array kernels
+          // when it has them, and otherwise loop over the scalar calls
+          // (which are at least direct, inlinable calls here).
+          //
+
+          void sampleUniformMany (void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const override
+          {
+            if constexpr (OmplBatchSamplingSpace<SpaceType>()) {
+              SubstateType* casted_outStates[kBlockSize];
+              castPointers(outStates, numStates, casted_outStates);
+              _spSpace->sampleUniformMany(casted_outStates, numStates, rng);
+            }
+            else {
+              for (size_t idx = 0; idx < numStates; ++idx) {
+                _spSpace->sampleUniform(*static_cast<SubstateType*>(outStates[idx]), rng);
+              }
+            }
+          }
+
+          void sampleUniformNearMany (const void* const* states, double distance, void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const override
+          {
+            if constexpr (OmplBatchSamplingSpace<SpaceType>()) {
+              const SubstateType* casted_states[kBlockSize];
+              SubstateType*       casted_outStates[kBlockSize];
+              castPointers(states,    numStates, casted_states);
+              castPointers(outStates, numStates, casted_outStates);
+              _spSpace->sampleUniformNearMany(casted_states, distance, casted_outStates, numStates, rng);
+            }
+            else {
+              for (size_t idx = 0; idx < numStates; ++idx) {
+                _spSpace->sampleUniformNear(*static_cast<const SubstateType*>(states[idx]), distance, *static_cast<SubstateType*>(outStates[idx]), rng);
+              }
+            }
+          }
+
+          void sampleGaussianNearMany (const void* const* states, double stddev, void* const* outStates, size_t numStates, RandomNumberGenerator& rng) const override
+          {
+            if constexpr (OmplBatchSamplingSpace<SpaceType>()) {
+              const SubstateType* casted_states[kBlockSize];
+              SubstateType*       casted_outStates[kBlockSize];
+              castPointers(states,    numStates, casted_states);
+              castPointers(outStates, numStates, casted_outStates);
+              _spSpace->sampleGaussianNearMany(casted_states, stddev, casted_outStates, numStates, rng);
+            }
+            else {
+              for (size_t idx = 0; idx < numStates; ++idx) {
+                _spSpace->sampleGaussianNear(*static_cast<const SubstateType*>(states[idx]), stddev, *static_cast<SubstateType*>(outStates[idx]), rng);
+              }
+            }
+          }
+
+          void accumulateDistanceMany (const void* fromState, const void* const* toStates, size_t numStates, double weight, double* outDistances) const override
+          {
+            const SubstateType& casted_fromState = *static_cast<const SubstateType*>(fromState);
+            if constexpr (OmplBatchMetricSpace<SpaceType>()) {
+              // Zeroed so that the compiler need not bound numStates by
+              // kBlockSize to see that the arrays are initialized.
+              const SubstateType* casted_toStates[kBlockSize]{};
+              double              distances[kBlockSize]{};
+              castPointers(toStates, numStates, casted_toStates);
+              _spSpace->distanceMany(casted_fromState, casted_toStates, numStates, distances);
+              for (size_t idx = 0; idx < numStates; ++idx) {
+                outDistances[idx] += weight*distances[idx];
+              }
+            }
+            else {
+              for (size_t idx = 0; idx < numStates; ++idx) {
+                outDistances[idx] += weight*_spSpace->distance(casted_fromState, *static_cast<const SubstateType*>(toStates[idx]));
+              }
+            }
+          }
+
+          void interpolateMany (const void* const* fromStates, const void* const* toStates, size_t numStates, double tt, void* const* outStates) const override
+          {
+            if constexpr (OmplBatchMetricSpace<SpaceType>()) {
+              const SubstateType* casted_fromStates[kBlockSize];
+              const SubstateType* casted_toStates[kBlockSize];
+              SubstateType*       casted_outStates[kBlockSize];
+              castPointers(fromStates, numStates, casted_fromStates);
+              castPointers(toStates,   numStates, casted_toStates);
+              castPointers(outStates,  numStates, casted_outStates);
+              _spSpace->interpolateMany(casted_fromStates, casted_toStates, numStates, tt, casted_outStates);
+            }
+            else {
+              for (size_t idx = 0; idx < numStates; ++idx) {
+                _spSpace->interpolate(*static_cast<const SubstateType*>(fromStates[idx]), *static_cast<const SubstateType*>(toStates[idx]),
+                                   tt, *static_cast<SubstateType*>(outStates[idx]));
+              }
+            }
+          }
+
+          void appendSchema (string& schema) const override
+          {
+            if constexpr (OmplSerializableSpace<SpaceType>()) {
+              _spSpace->appendSchema(schema);
+            }
+            else {
+              throw logic_error{"compound subspace is not serializable"};
+            }
+          }
+
+          size_t getSerializationSize () const override
+          {
+            if constexpr (OmplSerializableSpace<SpaceType>()) {
+              return _spSpace->getSerializationSize();
+            }
+            else {
+              throw logic_error{"compound subspace is not serializable"};
+            }
+          }
 
-          void sampleUniform (State::Substate& outState) const override
+          void serialize (const void* state, unsigned char* outBytes) const override
           {
-            typename SpaceType::StateType& casted_outState = any_cast<typename SpaceType::StateType&>(outState.anyOfState());
-            _space.sampleUniform(casted_outState);
+            if constexpr (OmplSerializableSpace<SpaceType>()) {
+              _spSpace->serialize(*static_cast<const SubstateType*>(state), outBytes);
+            }
+            else {
+              throw logic_error{"compound subspace is not serializable"};
+            }
           }
 
-          void sampleUniformNear (const State::Substate& state, double distance, State::Substate& outState) const override
+          void deserialize (const unsigned char* bytes, void* outState) const override
           {
-            const typename SpaceType::StateType& casted_state    = any_cast<const typename SpaceType::StateType&>(state.anyOfState());
-            typename       SpaceType::StateType& casted_outState = any_cast<typename       SpaceType::StateType&>(outState.anyOfState());
-            _space.sampleUniformNear(casted_state, distance, casted_outState);
+            if constexpr (OmplSerializableSpace<SpaceType>()) {
+              _spSpace->deserialize(bytes, *static_cast<SubstateType*>(outState));
+            }
+            else {
+              throw logic_error{"compound subspace is not serializable"};
+            }
           }
 
-          void sampleGaussianNear (const State::Substate& state, double stddev, State::Substate& outState) const override
+          template <typename VoidPointerType, typename TypedPointerType>
+          static void castPointers (const VoidPointerType* pointers, size_t numPointers, TypedPointerType* outPointers)
           {
-            const typename SpaceType::StateType& casted_state    = any_cast<const typename SpaceType::StateType&>(state.anyOfState());
-            typename       SpaceType::StateType& casted_outState = any_cast<typename       SpaceType::StateType&>(outState.anyOfState());
-            _space.sampleGaussianNear(casted_state, stddev, casted_outState);
+            for (size_t idx = 0; idx < numPointers; ++idx) {
+              outPointers[idx] = static_cast<TypedPointerType>(pointers[idx]);
+            }
           }
 
-          SpaceType _space;
+          SpaceHandle<SpaceType> _spSpace;
         };
 
-        unique_ptr<SubspaceConcept> _upSubspaceConcept;
+        shared_ptr<const SubspaceConcept> _spSubspaceConcept;
       };
 
     public:
@@ -368,9 +1117,20 @@ namespace spaces
         // cout << "Space ctor" << endl;
       }
 
+      //
+      // Subspaces are always sampled from the compound space's stream
+      // (or from the stream passed to a sampling call), never from the
+      // generators of the spaces that were added.
+      //
+      explicit Space (const RandomNumberGenerator& rng)
+        : _rng{rng}
+      { }
+
       Space (const Space& orig)
         : _protoState{orig._protoState}
         , _subspaces{orig._subspaces}
+        , _weights{orig._weights}
+        , _rng{orig._rng}
       {
         // cout << "Space copy ctor" << endl;
       }
@@ -378,6 +1138,8 @@ namespace spaces
       Space (Space&& sink) noexcept
         : _protoState{move(sink._protoState)}
         , _subspaces{move(sink._subspaces)}
+        , _weights{move(sink._weights)}
+        , _rng{sink._rng}
       {
         // cout << "Space move ctor" << endl;
       }
@@ -391,7 +1153,11 @@ namespace spaces
       Space& operator= (Space&& sink)
       {
         // cout << "Space move assignment" << endl;
-        return *this = sink;
+        _protoState = move(sink._protoState);
+        _subspaces  = move(sink._subspaces);
+        _weights    = move(sink._weights);
+        _rng        = sink._rng;
+        return *this;
       }
 
       ~Space ()
@@ -399,31 +1165,89 @@ namespace spaces
         // cout << "Space dtor" << endl;
       }
 
+      //
+      // The weight scales the subspace's contribution to distance
+      // and getMaximumExtent, and should be non-negative.
+      //
       template <OmplSpace SpaceType>
-      void addSubspace (const SpaceType& space)
+      void addSubspace (const SpaceType& space, double weight=1.0)
       {
         // cout << "addSubspace lvalue" << endl;
         _protoState.addSubstate(space.makeState());
         _subspaces.emplace_back(space);
+        _weights.push_back(weight);
       }
 
       template <OmplSpace SpaceType>
-      void addSubspace (SpaceType&& sink)
+      void addSubspace (SpaceType&& sink, double weight=1.0)
       {
         // cout << "addSubspace rvalue" << endl;
         _protoState.addSubstate(sink.makeState());
         _subspaces.emplace_back(std::forward<SpaceType>(sink));
+        _weights.push_back(weight);
       }
 
+      //
+      // Adds a subspace by handle, sharing the space instead of
+      // copying it.
+      //
+      template <OmplSpace SpaceType>
+      void addSubspace (SpaceHandle<SpaceType> spSpace, double weight=1.0)
+      {
+        _protoState.addSubstate(spSpace->makeState());
+        _subspaces.emplace_back(move(spSpace));
+        _weights.push_back(weight);
+      }
+
+      //
+      // Adding a compound space flattens it: its leaf subspaces are
+      // added individually (with their weights multiplied by weight),
+      // so operations never recurse through a nested compound.  The
+      // nesting is kept in the layout's structure tree for drawing and
+      // path access.  space may be *this.
+      //
+      void addSubspace (const Space& space, double weight=1.0)
+      {
+        const vector<Subspace> subspaces{space._subspaces};
+        const vector<double>   weights{space._weights};
+        _protoState.addSubstates(space._protoState);
+        for (size_t idx = 0; idx < subspaces.size(); ++idx) {
+          _subspaces.push_back(subspaces[idx]);
+          _weights.push_back(weight*weights[idx]);
+        }
+      }
+
+      void addSubspace (Space&& sink, double weight=1.0)
+      { addSubspace(static_cast<const Space&>(sink), weight); }
+
+      void addSubspace (SpaceHandle<Space> spSpace, double weight=1.0)
+      { addSubspace(*spSpace, weight); }
+
       friend void draw (const Space& space, ostream& ostr, size_t indent)
+      { space.drawNode(space.structure(), ostr, indent); }
+
+      //
+      // The number of leaf subspaces, and the leaf index of the
+      // subspace at path (see State::getSubstate).  Leaf indices are
+      // what setSubspaceWeight and getSubspaceWeight take.
+      //
+      size_t getNumSubspaces () const
+      { return _subspaces.size(); }
+
+      size_t getSubspaceIndex (initializer_list<size_t> path) const
       {
-        cout << "begin compound space" << endl;
-        for (const auto& subspace : space._subspaces) {
-          draw(subspace, ostr, indent + 2);
+        if (!_protoState._spLayout) {
+          throw out_of_range{"Compound::Space: invalid subspace path"};
         }
-        cout << "end compound space" << endl;
+        return _protoState._spLayout->slotIndex(path);
       }
 
+      void setSubspaceWeight (size_t idx, double weight)
+      { _weights[idx] = weight; }
+
+      double getSubspaceWeight (size_t idx) const
+      { return _weights[idx]; }
+
       State makeState () const
       { return _protoState; }
 
@@ -444,9 +1268,13 @@ namespace spaces
       }
 
       void sampleUniform (State& outState) const
+      { sampleUniform(outState, _rng); }
+
+      void sampleUniform (State& outState, RandomNumberGenerator& rng) const
       {
-        for (int idx=0; idx<_subspaces.size(); ++idx) {
-          _subspaces[idx].sampleUniform(outState._substates[idx]);
+        checkLayout(outState);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          _subspaces[idx].sampleUniform(outState.substateData(idx), rng);
         }
       }
 
@@ -458,9 +1286,14 @@ namespace spaces
       }
 
       void sampleUniformNear (const State& state, double distance, State& outState) const
+      { sampleUniformNear(state, distance, outState, _rng); }
+
+      void sampleUniformNear (const State& state, double distance, State& outState, RandomNumberGenerator& rng) const
       {
-        for (int idx=0; idx<_subspaces.size(); ++idx) {
-          _subspaces[idx].sampleUniformNear(state._substates[idx], distance, outState._substates[idx]);
+        checkLayout(state);
+        checkLayout(outState);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          _subspaces[idx].sampleUniformNear(state.substateData(idx), distance, outState.substateData(idx), rng);
         }
       }
 
@@ -472,17 +1305,368 @@ namespace spaces
       }
 
       void sampleGaussianNear (const State& state, double stddev, State& outState) const
+      { sampleGaussianNear(state, stddev, outState, _rng); }
+
+      void sampleGaussianNear (const State& state, double stddev, State& outState, RandomNumberGenerator& rng) const
+      {
+        checkLayout(state);
+        checkLayout(outState);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          _subspaces[idx].sampleGaussianNear(state.substateData(idx), stddev, outState.substateData(idx), rng);
+        }
+      }
+
+      //
+      // Each subspace consumes the next getDimension() coordinates,
+      // in the order the subspaces were added.
+      //
+      void sampleFromUnitCube (const double* unitCoords, State& outState) const
+      {
+        checkLayout(outState);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          _subspaces[idx].sampleFromUnitCube(unitCoords, outState.substateData(idx));
+          unitCoords += _subspaces[idx].getDimension();
+        }
+      }
+
+      //
+      // Weighted sum of the subspace distances.
+      //
+      double distance (const State& fromState, const State& toState) const
+      {
+        checkLayout(fromState);
+        checkLayout(toState);
+        double dist = 0.0;
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          dist += _weights[idx]*_subspaces[idx].distance(fromState.substateData(idx), toState.substateData(idx));
+        }
+        return dist;
+      }
+
+      State interpolate (const State& fromState, const State& toState, double tt) const
+      {
+        State outState{_protoState};
+        interpolate(fromState, toState, tt, outState);
+        return outState;
+      }
+
+      void interpolate (const State& fromState, const State& toState, double tt, State& outState) const
+      {
+        checkLayout(fromState);
+        checkLayout(toState);
+        checkLayout(outState);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          _subspaces[idx].interpolate(fromState.substateData(idx), toState.substateData(idx), tt, outState.substateData(idx));
+        }
+      }
+
+      bool satisfiesBounds (const State& state) const
+      {
+        checkLayout(state);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          if (!_subspaces[idx].satisfiesBounds(state.substateData(idx))) {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      void enforceBounds (State& state) const
+      {
+        checkLayout(state);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          _subspaces[idx].enforceBounds(state.substateData(idx));
+        }
+      }
+
+      double getMaximumExtent () const
+      {
+        double extent = 0.0;
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          extent += _weights[idx]*_subspaces[idx].getMaximumExtent();
+        }
+        return extent;
+      }
+
+      //
+      // Product of the subspace measures, skipping zero-dimensional
+      // subspaces.
+      //
+      double getMeasure () const
+      {
+        double measure = 1.0;
+        for (const auto& subspace : _subspaces) {
+          if (subspace.getDimension() > 0) {
+            measure *= subspace.getMeasure();
+          }
+        }
+        return measure;
+      }
+
+      //
+      // Binary serialization.  A state is stored as its leaf substates'
+      // bytes, back to back in leaf order, so getSerializationSize is
+      // fixed for the space.  The schema mirrors the nesting, e.g.
+      // "Compound(SO2,Compound(RealVector<3>,SO2))", and is what two
+      // spaces must agree on to exchange states.  deserialize needs an
+      // outState with this space's layout.  All of them throw
+      // logic_error if a subspace is not an OmplSerializableSpace.
+      //
+      void appendSchema (string& schema) const
+      { appendSchema(structure(), schema); }
+
+      size_t getSerializationSize () const
+      {
+        size_t size = 0;
+        for (const auto& subspace : _subspaces) {
+          size += subspace.getSerializationSize();
+        }
+        return size;
+      }
+
+      void serialize (const State& state, unsigned char* outBytes) const
       {
-        for (int idx=0; idx<_subspaces.size(); ++idx) {
-          _subspaces[idx].sampleGaussianNear(state._substates[idx], stddev, outState._substates[idx]);
+        checkLayout(state);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          _subspaces[idx].serialize(state.substateData(idx), outBytes);
+          outBytes += _subspaces[idx].getSerializationSize();
         }
       }
 
+      void deserialize (const unsigned char* bytes, State& outState) const
+      {
+        checkLayout(outState);
+        for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+          _subspaces[idx].deserialize(bytes, outState.substateData(idx));
+          bytes += _subspaces[idx].getSerializationSize();
+        }
+      }
+
+      //
+      // Batch versions.  These run subspace by subspace over blocks of
+      // states, so there is one virtual call per subspace per block
+      // rather than per state, and subspaces with pointer-array
+      // kernels (see OmplBatchSamplingSpace) process whole columns.
+      // Each takes either an array of states or an array of pointers to
+      // states (e.g. from Arena::allocStates).  Output states must
+      // already have this space's layout (e.g. from makeState or an
+      // Arena made from this space);
+      // as with the scalar calls, any other state throws
+      // invalid_argument before anything is written.
+      //
+      // The batch samplers consume the stream column by column, so
+      // they do not reproduce the samples of repeated scalar calls.
+      //
+
+      void sampleUniformMany (State* outStates, size_t numStates) const
+      { sampleUniformMany(outStates, numStates, _rng); }
+
+      void sampleUniformMany (State* outStates, size_t numStates, RandomNumberGenerator& rng) const
+      { sampleUniformManyImpl(outStates, numStates, rng); }
+
+      void sampleUniformMany (State* const* outStates, size_t numStates) const
+      { sampleUniformMany(outStates, numStates, _rng); }
+
+      void sampleUniformMany (State* const* outStates, size_t numStates, RandomNumberGenerator& rng) const
+      { sampleUniformManyImpl(outStates, numStates, rng); }
+
+      void sampleUniformNearMany (const State* states, double distance, State* outStates, size_t numStates) const
+      { sampleUniformNearMany(states, distance, outStates, numStates, _rng); }
+
+      void sampleUniformNearMany (const State* states, double distance, State* outStates, size_t numStates, RandomNumberGenerator& rng) const
+      { sampleNearManyImpl(states, distance, outStates, numStates, rng, &Subspace::sampleUniformNearMany); }
+
+      void sampleUniformNearMany (const State* const* states, double distance, State* const* outStates, size_t numStates) const
+      { sampleUniformNearMany(states, distance, outStates, numStates, _rng); }
+
+      void sampleUniformNearMany (const State* const* states, double distance, State* const* outStates, size_t numStates, RandomNumberGenerator& rng) const
+      { sampleNearManyImpl(states, distance, outStates, numStates, rng, &Subspace::sampleUniformNearMany); }
+
+      void sampleGaussianNearMany (const State* states, double stddev, State* outStates, size_t numStates) const
+      { sampleGaussianNearMany(states, stddev, outStates, numStates, _rng); }
+
+      void sampleGaussianNearMany (const State* states, double stddev, State* outStates, size_t numStates, RandomNumberGenerator& rng) const
+      { sampleNearManyImpl(states, stddev, outStates, numStates, rng, &Subspace::sampleGaussianNearMany); }
+
+      void sampleGaussianNearMany (const State* const* states, double stddev, State* const* outStates, size_t numStates) const
+      { sampleGaussianNearMany(states, stddev, outStates, numStates, _rng); }
+
+      void sampleGaussianNearMany (const State* const* states, double stddev, State* const* outStates, size_t numStates, RandomNumberGenerator& rng) const
+      { sampleNearManyImpl(states, stddev, outStates, numStates, rng, &Subspace::sampleGaussianNearMany); }
+
+      void distanceMany (const State& fromState, const State* toStates, size_t numStates, double* outDistances) const
+      { distanceManyImpl(fromState, toStates, numStates, outDistances); }
+
+      void distanceMany (const State& fromState, const State* const* toStates, size_t numStates, double* outDistances) const
+      { distanceManyImpl(fromState, toStates, numStates, outDistances); }
+
+      void interpolateMany (const State* fromStates, const State* toStates, size_t numStates, double tt, State* outStates) const
+      { interpolateManyImpl(fromStates, toStates, numStates, tt, outStates); }
+
+      void interpolateMany (const State* const* fromStates, const State* const* toStates, size_t numStates, double tt, State* const* outStates) const
+      { interpolateManyImpl(fromStates, toStates, numStates, tt, outStates); }
+
     private:
-      State            _protoState;
-      vector<Subspace> _subspaces;
+      static constexpr size_t kBlockSize = 64;
+
+      //
+      // The batch implementations are written once for both arrays of
+      // states and arrays of pointers to states.
+      //
+      static const State& stateAt (const State* states, size_t idx)
+      { return states[idx]; }
+
+      static const State& stateAt (const State* const* states, size_t idx)
+      { return *states[idx]; }
+
+      static State& stateAt (State* states, size_t idx)
+      { return states[idx]; }
+
+      static State& stateAt (State* const* states, size_t idx)
+      { return *states[idx]; }
+
+      //
+      // Substates are found by their offsets in this space's layout, so
+      // every state passed in must have been made by this space or a
+      // copy of it (which share the layout).  A default-constructed
+      // state, one made by another space or one made before the last
+      // addSubspace has a different layout.
+      //
+      void checkLayout (const State& state) const
+      {
+        if (state._spLayout != _protoState._spLayout) {
+          throw invalid_argument{"Compound::Space: state was not made by this space"};
+        }
+      }
+
+      template <typename StatesType>
+      void checkLayouts (StatesType states, size_t numStates) const
+      {
+        for (size_t idx = 0; idx < numStates; ++idx) {
+          checkLayout(stateAt(states, idx));
+        }
+      }
+
+      template <typename OutStatesType>
+      void sampleUniformManyImpl (OutStatesType outStates, size_t numStates, RandomNumberGenerator& rng) const
+      {
+        checkLayouts(outStates, numStates);
+        void* outSubstates[kBlockSize];
+        for (size_t begin = 0; begin < numStates; begin += kBlockSize) {
+          const size_t count = min(kBlockSize, numStates - begin);
+          for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+            for (size_t jj = 0; jj < count; ++jj) {
+              outSubstates[jj] = stateAt(outStates, begin + jj).substateData(idx);
+            }
+            _subspaces[idx].sampleUniformMany(outSubstates, count, rng);
+          }
+        }
+      }
+
+      template <typename StatesType, typename OutStatesType, typename SubspaceMethod>
+      void sampleNearManyImpl (StatesType states, double param, OutStatesType outStates, size_t numStates, RandomNumberGenerator& rng, SubspaceMethod method) const
+      {
+        checkLayouts(states, numStates);
+        checkLayouts(outStates, numStates);
+        const void* substates[kBlockSize];
+        void*       outSubstates[kBlockSize];
+        for (size_t begin = 0; begin < numStates; begin += kBlockSize) {
+          const size_t count = min(kBlockSize, numStates - begin);
+          for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+            for (size_t jj = 0; jj < count; ++jj) {
+              substates[jj]    = stateAt(states,    begin + jj).substateData(idx);
+              outSubstates[jj] = stateAt(outStates, begin + jj).substateData(idx);
+            }
+            (_subspaces[idx].*method)(substates, param, outSubstates, count, rng);
+          }
+        }
+      }
+
+      template <typename StatesType>
+      void distanceManyImpl (const State& fromState, StatesType toStates, size_t numStates, double* outDistances) const
+      {
+        checkLayout(fromState);
+        checkLayouts(toStates, numStates);
+        const void* toSubstates[kBlockSize];
+        for (size_t begin = 0; begin < numStates; begin += kBlockSize) {
+          const size_t count = min(kBlockSize, numStates - begin);
+          fill(outDistances + begin, outDistances + begin + count, 0.0);
+          for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+            for (size_t jj = 0; jj < count; ++jj) {
+              toSubstates[jj] = stateAt(toStates, begin + jj).substateData(idx);
+            }
+            _subspaces[idx].accumulateDistanceMany(fromState.substateData(idx), toSubstates, count, _weights[idx], outDistances + begin);
+          }
+        }
+      }
+
+      template <typename StatesType, typename OutStatesType>
+      void interpolateManyImpl (StatesType fromStates, StatesType toStates, size_t numStates, double tt, OutStatesType outStates) const
+      {
+        checkLayouts(fromStates, numStates);
+        checkLayouts(toStates, numStates);
+        checkLayouts(outStates, numStates);
+        const void* fromSubstates[kBlockSize];
+        const void* toSubstates[kBlockSize];
+        void*       outSubstates[kBlockSize];
+        for (size_t begin = 0; begin < numStates; begin += kBlockSize) {
+          const size_t count = min(kBlockSize, numStates - begin);
+          for (size_t idx=0; idx<_subspaces.size(); ++idx) {
+            for (size_t jj = 0; jj < count; ++jj) {
+              fromSubstates[jj] = stateAt(fromStates, begin + jj).substateData(idx);
+              toSubstates[jj]   = stateAt(toStates,   begin + jj).substateData(idx);
+              outSubstates[jj]  = stateAt(outStates,  begin + jj).substateData(idx);
+            }
+            _subspaces[idx].interpolateMany(fromSubstates, toSubstates, count, tt, outSubstates);
+          }
+        }
+      }
+
+      const Layout::Node& structure () const
+      {
+        static const Layout::Node emptyRoot;
+        return _protoState._spLayout ? _protoState._spLayout->root : emptyRoot;
+      }
+
+      void appendSchema (const Layout::Node& node, string& schema) const
+      {
+        if (node.isLeaf()) {
+          _subspaces[node.slotIdx].appendSchema(schema);
+          return;
+        }
+        schema += "Compound(";
+        for (size_t idx = 0; idx < node.children.size(); ++idx) {
+          if (idx > 0) {
+            schema += ',';
+          }
+          appendSchema(node.children[idx], schema);
+        }
+        schema += ')';
+      }
+
+      void drawNode (const Layout::Node& node, ostream& ostr, size_t indent) const
+      {
+        if (node.isLeaf()) {
+          draw(_subspaces[node.slotIdx], ostr, indent);
+          return;
+        }
+        ostr << string(indent, ' ') << "begin compound space" << endl;
+        for (const auto& child : node.children) {
+          drawNode(child, ostr, indent + 2);
+        }
+        ostr << string(indent, ' ') << "end compound space" << endl;
+      }
+
+      State                         _protoState;
+      vector<Subspace>              _subspaces;
+      vector<double>                _weights;
+      mutable RandomNumberGenerator _rng;
     };
 
+    inline Arena::Arena (const Space& space)
+      : Arena{space.makeState()}
+    { }
+
   }
 }
 
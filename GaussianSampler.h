@@ -1,48 +1,501 @@
 #ifndef __GAUSSIAN_SAMPLER_H__
 #define __GAUSSIAN_SAMPLER_H__
 
+#include "BatchValidity.h"
+#include "RandomNumberGenerator.h"
+#include "SampleBatch.h"
+#include "SpaceHandle.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
 namespace Samplers
 {
+  //
+  // Draws pairs as ValidatingGaussianSampler (below) does, a uniform
+  // center and a Gaussian state near it, but without a validity
+  // checker there is no Gaussian rule to apply: sample() returns the
+  // near state unchecked.  Use ValidatingGaussianSampler for Gaussian
+  // sampling proper; this one serves callers that check samples
+  // themselves, such as SampleProducerPool.
+  //
+  // The center is drawn into a scratch state, which makes sample()
+  // unsafe to call on one sampler from several threads.
+  //
   template<typename SpaceType>
   class GaussianSampler
   {
   public:
-    // TODO: This should eventually take a state validator as well.
-    GaussianSampler (SpaceType space, double stddev)
-      : _space(space)
+    typedef typename SpaceType::StateType StateType;
+
+    //
+    // The sampler refers to the space through a shared handle, so
+    // constructing many samplers over one space copies nothing but
+    // the handle.  Passing a space by value wraps it in a new handle.
+    //
+    GaussianSampler (SpaceHandle<SpaceType> spSpace, double stddev)
+      : _spSpace(std::move(spSpace))
+      , _stddev(stddev)
+      , _center(_spSpace->makeState())
+    { }
+
+    GaussianSampler (SpaceHandle<SpaceType> spSpace, double stddev, const RandomNumberGenerator& rng)
+      : _spSpace(std::move(spSpace))
       , _stddev(stddev)
+      , _rng(rng)
+      , _center(_spSpace->makeState())
+    { }
+
+    GaussianSampler (SpaceType space, double stddev)
+      : GaussianSampler(makeSpaceHandle(std::move(space)), stddev)
+    { }
+
+    GaussianSampler (SpaceType space, double stddev, const RandomNumberGenerator& rng)
+      : GaussianSampler(makeSpaceHandle(std::move(space)), stddev, rng)
     { }
 
     GaussianSampler (const GaussianSampler<SpaceType>& orig)            = default;
+    GaussianSampler (GaussianSampler<SpaceType>&& sink)                 = default;
     GaussianSampler& operator= (const GaussianSampler<SpaceType>& orig) = default;
+    GaussianSampler& operator= (GaussianSampler<SpaceType>&& sink)      = default;
     ~GaussianSampler ()                                                 = default;
 
-    bool sample (typename SpaceType::StateType& outState) const;
+    const SpaceHandle<SpaceType>& getSpace () const
+    { return _spSpace; }
+
+    //
+    // The single-argument form draws from the sampler's own stream;
+    // the other draws from the given one.
+    //
+    bool sample (StateType& outState) const;
+    bool sample (StateType& outState, RandomNumberGenerator& rng) const;
 
   private:
-    SpaceType _space;
-    double    _stddev;
+    SpaceHandle<SpaceType>        _spSpace;
+    double                        _stddev;
+    mutable RandomNumberGenerator _rng;
+    mutable StateType             _center;   // scratch
   };
 
   template<typename SpaceType>
-  bool GaussianSampler<SpaceType>::sample (typename SpaceType::StateType& outState) const
+  bool GaussianSampler<SpaceType>::sample (StateType& outState) const
+  { return sample(outState, _rng); }
+
+  template<typename SpaceType>
+  bool GaussianSampler<SpaceType>::sample (StateType& outState, RandomNumberGenerator& rng) const
   {
-    typedef typename SpaceType::StateType StateType;
+    _spSpace->sampleUniform(_center, rng);
+    _spSpace->sampleGaussianNear(_center, _stddev, outState, rng);
+    return true;
+  }
+
+  //
+  // Gaussian sampling against a state validity checker: draw a uniform
+  // sample and a Gaussian sample near it, and keep the valid one when
+  // exactly one of the pair is valid.  Samples therefore concentrate
+  // near obstacle boundaries and in narrow passages.
+  //
+  // Since most pairs are rejected, they are drawn kBatchSize at a time
+  // into scratch states (see SampleBatch) and then validated in order
+  // until one is accepted.  Batch-capable checkers (see
+  // OmplBatchValidityChecker) instead check all of a batch's states
+  // in two calls, and later sample() calls return the batch's other
+  // accepted pairs before drawing a new one, whichever stream they are
+  // given.  The scratch makes sample() unsafe to call on one sampler
+  // from several threads; give each thread its own copy.
+  //
+  // The sampler keeps statistics over a sliding window of recent pairs
+  // (see getStatistics).  With adaptation enabled it also tunes the
+  // standard deviation towards a target acceptance rate: too small a
+  // stddev puts both ends of most pairs on the same side of every
+  // obstacle boundary, and too large a one approaches independent
+  // uniform pairs, so a larger stddev accepts more pairs but places the
+  // samples less tightly along the boundaries.  The validity-check
+  // cost enters through an optional budget of check time per sample
+  // (see setMaxCheckSecondsPerSample), which raises the target when
+  // checks are expensive.
+  //
+  template<typename ValidatorType>
+  class ValidatingGaussianSampler
+  {
+  public:
+    typedef typename ValidatorType::SpaceType SpaceType;
+    typedef typename ValidatorType::StateType StateType;
+
+    static constexpr std::size_t kBatchSize = 64;
+
+    // Pairs accept at most half the time when their ends are valid
+    // independently, so a cost budget never raises the target past this.
+    static constexpr double kMaxTargetAcceptance = 0.4;
+
+    ValidatingGaussianSampler (const ValidatorType& validator, SpaceHandle<SpaceType> spSpace, double stddev)
+      : _validator(validator)
+      , _spSpace(std::move(spSpace))
+      , _stddev(stddev)
+    { }
+
+    ValidatingGaussianSampler (const ValidatorType& validator, SpaceHandle<SpaceType> spSpace, double stddev,
+                               const RandomNumberGenerator& rng)
+      : _validator(validator)
+      , _spSpace(std::move(spSpace))
+      , _stddev(stddev)
+      , _rng(rng)
+    { }
+
+    ValidatingGaussianSampler (const ValidatorType& validator, SpaceType space, double stddev)
+      : ValidatingGaussianSampler(validator, makeSpaceHandle(std::move(space)), stddev)
+    { }
+
+    ValidatingGaussianSampler (const ValidatorType& validator, SpaceType space, double stddev,
+                               const RandomNumberGenerator& rng)
+      : ValidatingGaussianSampler(validator, makeSpaceHandle(std::move(space)), stddev, rng)
+    { }
+
+    ValidatingGaussianSampler (const ValidatingGaussianSampler& orig)            = default;
+    ValidatingGaussianSampler (ValidatingGaussianSampler&& sink)                 = default;
+    ValidatingGaussianSampler& operator= (const ValidatingGaussianSampler& orig) = default;
+    ValidatingGaussianSampler& operator= (ValidatingGaussianSampler&& sink)      = default;
+    ~ValidatingGaussianSampler ()                                                = default;
+
+    const SpaceHandle<SpaceType>& getSpace () const
+    { return _spSpace; }
+
+    const ValidatorType& getValidator () const
+    { return _validator; }
+
+    void setValidator (const ValidatorType& validator)
+    { _validator = validator; }
+
+    //
+    // The number of pairs sample() draws before giving up and
+    // returning false.  0, the default, means it never gives up.
+    //
+    void setMaxAttempts (std::size_t maxAttempts)
+    { _maxAttempts = maxAttempts; }
+
+    std::size_t getMaxAttempts () const
+    { return _maxAttempts; }
+
+    double getStddev () const
+    { return _stddev; }
+
+    //
+    // Adjust the stddev after every batch, up when the acceptance rate
+    // over the last windowSize pairs is below targetAcceptance and down
+    // when it is above, by a factor of up to exp(kAdaptationGain) per
+    // windowSize pairs, keeping it within [minStddev, maxStddev].  targetAcceptance
+    // must be in (0, 1); since a pair's ends are valid independently
+    // at worst, it should be well below 0.5.
+    //
+    void enableAdaptation (double targetAcceptance, double minStddev, double maxStddev,
+                           std::size_t windowSize = kDefaultWindowSize)
+    {
+      _isAdaptive       = true;
+      _targetAcceptance = targetAcceptance;
+      _minStddev        = minStddev;
+      _maxStddev        = maxStddev;
+      setWindowSize(windowSize);
+    }
+
+    void disableAdaptation ()
+    { _isAdaptive = false; }
+
+    //
+    // A budget of validity-check time per sample, in seconds; 0, the
+    // default, means none.  Every pair costs two checks whatever the
+    // stddev, so a sample costs about 2*secondsPerCheck/acceptanceRate.
+    // While that is over budget, adaptation aims for the acceptance
+    // rate that fits it instead of targetAcceptance (but not above
+    // kMaxTargetAcceptance), trading some concentration along the
+    // boundaries for cheaper samples.
+    //
+    void setMaxCheckSecondsPerSample (double maxSeconds)
+    { _maxCheckSecondsPerSample = maxSeconds; }
+
+    double getMaxCheckSecondsPerSample () const
+    { return _maxCheckSecondsPerSample; }
 
-    bool validSampleFound = false;
-    do
+    bool isAdaptive () const
+    { return _isAdaptive; }
+
+    //
+    // The number of recent pairs the statistics cover.  The window
+    // holds whole batches, so it can exceed this by less than a batch.
+    //
+    void setWindowSize (std::size_t windowSize)
+    {
+      _windowSize = std::max<std::size_t>(windowSize, 1);
+      trimWindow();
+    }
+
+    std::size_t getWindowSize () const
+    { return _windowSize; }
+
+    struct Statistics
+    {
+      double      stddev;               // current standard deviation
+      double      targetAcceptance;     // acceptance rate adaptation aims for
+      double      acceptanceRate;       // accepted / checked pairs, in the window
+      double      checksPerSample;      // validity checks per accepted pair, in the window
+      double      secondsPerCheck;      // mean validity check time, in the window
+      std::size_t windowPairs;          // pairs the window covers
+      std::size_t totalPairs;           // pairs checked since construction
+      std::size_t totalSamples;         // samples returned since construction
+    };
+
+    Statistics getStatistics () const;
+
+    //
+    // The single-argument form draws from the sampler's own stream;
+    // the other draws from the given one.  outState is left unchanged
+    // if no sample is found.
+    //
+    bool sample (StateType& outState) const;
+    bool sample (StateType& outState, RandomNumberGenerator& rng) const;
+
+  private:
+    static constexpr std::size_t kDefaultWindowSize = 4096;
+    static constexpr double      kAdaptationGain    = 0.5;
+
+    //
+    // What one batch contributed: pairs checked, pairs accepted,
+    // validity checks and the time they took.  Checked one at a time,
+    // a batch is checked up to and including its first accepted pair;
+    // batch-capable checkers check all of it.
+    //
+    struct BatchRecord
+    {
+      std::size_t numPairs    = 0;
+      std::size_t numAccepted = 0;
+      std::size_t numChecks   = 0;
+      double      seconds     = 0.0;
+    };
+
+    //
+    // The masks of the last batch checked in full, and the first of its
+    // pairs not yet looked at.  Like the batch itself, it is not copied.
+    //
+    struct CheckedBatch
     {
-      StateType sample1 = _space.sampleUniform();
-      StateType sample2 = _space.sampleGaussianNear(sample1, _stddev);
+      std::uint64_t centerValidMask[getValidMaskWords(kBatchSize)];
+      std::uint64_t nearValidMask[getValidMaskWords(kBatchSize)];
+      std::size_t   next = 0;
+      std::size_t   size = 0;
 
-      // For the moment, assume that sample1 is invalid and
-      // that sample2 is valid.
-      outState = sample2;
-      validSampleFound = true;
-    } while (!validSampleFound);
+      CheckedBatch () = default;
+
+      CheckedBatch (const CheckedBatch&)
+      { }
+
+      CheckedBatch& operator= (const CheckedBatch&)
+      {
+        next = size = 0;
+        return *this;
+      }
+    };
+
+    bool   takeCheckedPair (StateType& outState) const;
+    void   record (const BatchRecord& batch) const;
+    void   trimWindow () const;
+    double getTargetAcceptance () const;
+    void   adapt (std::size_t numPairs) const;
+
+    ValidatorType                 _validator;
+    SpaceHandle<SpaceType>        _spSpace;
+    mutable double                _stddev;   // adapted by sample()
+    std::size_t                   _maxAttempts = 0;
+    mutable RandomNumberGenerator _rng;
+
+    bool        _isAdaptive               = false;
+    double      _targetAcceptance         = 0.0;
+    double      _minStddev                = 0.0;
+    double      _maxStddev                = 0.0;
+    double      _maxCheckSecondsPerSample = 0.0;
+    std::size_t _windowSize               = kDefaultWindowSize;
+
+    // The window's batches and their running totals.
+    mutable std::deque<BatchRecord> _window;
+    mutable BatchRecord             _windowTotals;
+    mutable std::size_t             _totalPairs   = 0;
+    mutable std::size_t             _totalSamples = 0;
+
+    // Scratch: _centers[i] and _nearStates[i] are the i'th pair.
+    mutable SampleBatch<SpaceType> _centers;
+    mutable SampleBatch<SpaceType> _nearStates;
+    mutable CheckedBatch           _checked;
+  };
+
+  template<typename ValidatorType>
+  bool ValidatingGaussianSampler<ValidatorType>::sample (StateType& outState) const
+  { return sample(outState, _rng); }
+
+  template<typename ValidatorType>
+  bool ValidatingGaussianSampler<ValidatorType>::sample (StateType& outState, RandomNumberGenerator& rng) const
+  {
+    if (takeCheckedPair(outState)) {
+      ++_totalSamples;
+      return true;
+    }
 
-    return validSampleFound;
+    _centers.allocate(*_spSpace, kBatchSize);
+    _nearStates.allocate(*_spSpace, kBatchSize);
+
+    std::size_t attempts = 0;
+    while (_maxAttempts == 0 || attempts < _maxAttempts) {
+      std::size_t numPairs = kBatchSize;
+      if (_maxAttempts != 0 && _maxAttempts - attempts < numPairs) {
+        numPairs = _maxAttempts - attempts;
+      }
+      _centers.sampleUniform(*_spSpace, numPairs, rng);
+      _nearStates.sampleGaussianNear(*_spSpace, _centers, _stddev, numPairs, rng);
+      attempts += numPairs;
+
+      BatchRecord batch;
+      const auto startTime = std::chrono::steady_clock::now();
+      if constexpr (OmplBatchValidityChecker<ValidatorType>()) {
+        _validator.isValidMany(_centers.data(),    numPairs, _checked.centerValidMask, false);
+        _validator.isValidMany(_nearStates.data(), numPairs, _checked.nearValidMask,   false);
+        for (std::size_t idx = 0; idx < numPairs; ++idx) {
+          if (isValidMaskBitSet(_checked.centerValidMask, idx) != isValidMaskBitSet(_checked.nearValidMask, idx)) {
+            ++batch.numAccepted;
+          }
+        }
+        batch.numPairs  = numPairs;
+        batch.numChecks = 2*numPairs;
+      }
+      else {
+        for (std::size_t idx = 0; idx < numPairs && batch.numAccepted == 0; ++idx) {
+          const bool centerIsValid = _validator.isValid(_centers[idx]);
+          if (_validator.isValid(_nearStates[idx]) != centerIsValid) {
+            outState = centerIsValid ? _centers[idx] : _nearStates[idx];
+            batch.numAccepted = 1;
+          }
+          ++batch.numPairs;
+        }
+        batch.numChecks = 2*batch.numPairs;
+      }
+      batch.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+      record(batch);
+      adapt(batch.numPairs);
+      if constexpr (OmplBatchValidityChecker<ValidatorType>()) {
+        _checked.next = 0;
+        _checked.size = numPairs;
+        if (takeCheckedPair(outState)) {
+          ++_totalSamples;
+          return true;
+        }
+      }
+      else if (batch.numAccepted > 0) {
+        ++_totalSamples;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  //
+  // Sets outState to the next accepted pair's valid state from the
+  // last batch checked in full, if it has one left.
+  //
+  template<typename ValidatorType>
+  bool ValidatingGaussianSampler<ValidatorType>::takeCheckedPair (StateType& outState) const
+  {
+    while (_checked.next < _checked.size) {
+      const std::size_t idx           = _checked.next++;
+      const bool        centerIsValid = isValidMaskBitSet(_checked.centerValidMask, idx);
+      if (isValidMaskBitSet(_checked.nearValidMask, idx) != centerIsValid) {
+        outState = centerIsValid ? _centers[idx] : _nearStates[idx];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template<typename ValidatorType>
+  typename ValidatingGaussianSampler<ValidatorType>::Statistics ValidatingGaussianSampler<ValidatorType>::getStatistics () const
+  {
+    Statistics statistics;
+    statistics.stddev           = _stddev;
+    statistics.targetAcceptance = getTargetAcceptance();
+    statistics.acceptanceRate   = _windowTotals.numPairs > 0 ? double(_windowTotals.numAccepted)/_windowTotals.numPairs : 0.0;
+    statistics.checksPerSample  = _windowTotals.numAccepted > 0 ? double(_windowTotals.numChecks)/_windowTotals.numAccepted : 0.0;
+    statistics.secondsPerCheck  = _windowTotals.numChecks > 0 ? _windowTotals.seconds/_windowTotals.numChecks : 0.0;
+    statistics.windowPairs      = _windowTotals.numPairs;
+    statistics.totalPairs       = _totalPairs;
+    statistics.totalSamples     = _totalSamples;
+    return statistics;
+  }
+
+  template<typename ValidatorType>
+  void ValidatingGaussianSampler<ValidatorType>::record (const BatchRecord& batch) const
+  {
+    _window.push_back(batch);
+    _windowTotals.numPairs    += batch.numPairs;
+    _windowTotals.numAccepted += batch.numAccepted;
+    _windowTotals.numChecks   += batch.numChecks;
+    _windowTotals.seconds     += batch.seconds;
+    _totalPairs               += batch.numPairs;
+    trimWindow();
+  }
+
+  //
+  // Drop the oldest batches while the rest still cover the window.
+  //
+  template<typename ValidatorType>
+  void ValidatingGaussianSampler<ValidatorType>::trimWindow () const
+  {
+    while (!_window.empty() && _windowTotals.numPairs - _window.front().numPairs >= _windowSize) {
+      const BatchRecord& oldest = _window.front();
+      _windowTotals.numPairs    -= oldest.numPairs;
+      _windowTotals.numAccepted -= oldest.numAccepted;
+      _windowTotals.numChecks   -= oldest.numChecks;
+      _windowTotals.seconds     -= oldest.seconds;
+      _window.pop_front();
+    }
+  }
+
+  //
+  // targetAcceptance, or the rate that would keep the window's check
+  // time per sample within budget if that is higher.
+  //
+  template<typename ValidatorType>
+  double ValidatingGaussianSampler<ValidatorType>::getTargetAcceptance () const
+  {
+    if (_maxCheckSecondsPerSample <= 0.0 || _windowTotals.numChecks == 0) {
+      return _targetAcceptance;
+    }
+    const double secondsPerCheck  = _windowTotals.seconds/_windowTotals.numChecks;
+    const double budgetAcceptance = std::min(2.0*secondsPerCheck/_maxCheckSecondsPerSample, kMaxTargetAcceptance);
+    return std::max(_targetAcceptance, budgetAcceptance);
+  }
+
+  //
+  // A multiplicative step on the relative acceptance error, so the
+  // stddev moves at the same pace whatever its scale, and in
+  // proportion to the pairs just checked, so the pace does not depend
+  // on how many pairs a batch took.  Nothing is changed until the
+  // window has filled, so early estimates from a few pairs do not
+  // throw the stddev off.
+  //
+  template<typename ValidatorType>
+  void ValidatingGaussianSampler<ValidatorType>::adapt (std::size_t numPairs) const
+  {
+    if (!_isAdaptive || _windowTotals.numPairs < _windowSize) {
+      return;
+    }
+    const double acceptanceRate = double(_windowTotals.numAccepted)/_windowTotals.numPairs;
+    const double target         = getTargetAcceptance();
+    const double error          = std::clamp((target - acceptanceRate)/target, -1.0, 1.0);
+    const double step           = kAdaptationGain*error*numPairs/_windowSize;
+    _stddev = std::clamp(_stddev*std::exp(step), _minStddev, _maxStddev);
   }
 }
 
-#endif // __GAUSSIAN_SAMPLER_H__
\ No newline at end of file
+#endif // __GAUSSIAN_SAMPLER_H__
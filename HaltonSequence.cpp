@@ -0,0 +1,73 @@
+#include "HaltonSequence.h"
+
+namespace
+{
+  std::vector<unsigned int> firstPrimes (unsigned int count)
+  {
+    std::vector<unsigned int> primes;
+    primes.reserve(count);
+    for (unsigned int candidate = 2; primes.size() < count; ++candidate) {
+      bool isPrime = true;
+      for (unsigned int prime : primes) {
+        if (prime*prime > candidate) {
+          break;
+        }
+        if (candidate % prime == 0) {
+          isPrime = false;
+          break;
+        }
+      }
+      if (isPrime) {
+        primes.push_back(candidate);
+      }
+    }
+    return primes;
+  }
+
+  double radicalInverse (std::uint64_t index, unsigned int base)
+  {
+    const double invBase = 1.0 / base;
+    double       factor  = invBase;
+    double       result  = 0.0;
+    while (index > 0) {
+      result += (index % base)*factor;
+      index  /= base;
+      factor *= invBase;
+    }
+    return result;
+  }
+}
+
+HaltonSequence::HaltonSequence (unsigned int dimension)
+  : _bases{firstPrimes(dimension)}
+  , _shifts(dimension, 0.0)
+  , _index{1}
+{ }
+
+HaltonSequence::HaltonSequence (unsigned int dimension, RandomNumberGenerator& rng)
+  : HaltonSequence{dimension}
+{ randomize(rng); }
+
+unsigned int HaltonSequence::getDimension () const
+{ return _bases.size(); }
+
+void HaltonSequence::next (double* outPoint)
+{
+  //
+  // Index 0 is the origin in every base, so the sequence starts at 1.
+  //
+  for (unsigned int dim = 0; dim < _bases.size(); ++dim) {
+    double coord = radicalInverse(_index, _bases[dim]) + _shifts[dim];
+    outPoint[dim] = (coord >= 1.0) ? (coord - 1.0) : coord;
+  }
+  ++_index;
+}
+
+void HaltonSequence::randomize (RandomNumberGenerator& rng)
+{
+  rng.realUniform_0_1(_shifts.data(), _shifts.size());
+  reset();
+}
+
+void HaltonSequence::reset ()
+{ _index = 1; }
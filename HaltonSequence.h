@@ -0,0 +1,47 @@
+#ifndef __HALTON_SEQUENCE_H__
+#define __HALTON_SEQUENCE_H__
+
+#include "RandomNumberGenerator.h"
+
+#include <cstdint>
+#include <vector>
+
+//
+// Low-discrepancy points in the unit cube [0,1)^d.
+//
+// Coordinate k of point i is the radical inverse of i in the k-th
+// prime base.  With a RandomNumberGenerator the sequence is randomized
+// by a Cranley-Patterson rotation (every coordinate is shifted by a
+// uniform offset, modulo 1), which keeps the low discrepancy but makes
+// independent runs statistically independent.
+//
+// Halton points are well distributed for the handful of dimensions
+// found in typical robot configurations; for many tens of dimensions
+// the coordinates in large prime bases become visibly correlated.
+//
+class HaltonSequence
+{
+public:
+  explicit HaltonSequence (unsigned int dimension);
+  HaltonSequence (unsigned int dimension, RandomNumberGenerator& rng);
+  HaltonSequence (const HaltonSequence& orig)            = default;
+  HaltonSequence& operator= (const HaltonSequence& orig) = default;
+  ~HaltonSequence ()                                     = default;
+
+  unsigned int getDimension () const;
+
+  // Write the next point into outPoint[0..getDimension()).
+  void next (double* outPoint);
+
+  // Draw a new rotation and restart the sequence.
+  void randomize (RandomNumberGenerator& rng);
+
+  void reset ();
+
+private:
+  std::vector<unsigned int> _bases;
+  std::vector<double>       _shifts;
+  std::uint64_t             _index;
+};
+
+#endif // __HALTON_SEQUENCE_H__
@@ -0,0 +1,135 @@
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  [[noreturn]] void throwSystemError (const std::string& what, const std::string& path)
+  { throw std::system_error{errno, std::generic_category(), what + " " + path}; }
+}
+
+MappedFile::MappedFile (const std::string& path, Mode mode)
+  : _path{path}
+  , _mode{mode}
+{
+  int flags = O_RDONLY;
+  if (mode == Mode::ReadWrite) {
+    flags = O_RDWR;
+  }
+  else if (mode == Mode::Create) {
+    flags = O_RDWR | O_CREAT | O_TRUNC;
+  }
+
+  _fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (_fd < 0) {
+    throwSystemError("cannot open", path);
+  }
+
+  struct stat status;
+  if (::fstat(_fd, &status) != 0) {
+    const int error = errno;
+    ::close(_fd);
+    errno = error;
+    throwSystemError("cannot stat", path);
+  }
+  _size = static_cast<std::size_t>(status.st_size);
+
+  try {
+    map();
+  }
+  catch (...) {
+    ::close(_fd);
+    throw;
+  }
+}
+
+MappedFile::MappedFile (MappedFile&& sink) noexcept
+{ swap(sink); }
+
+MappedFile& MappedFile::operator= (MappedFile&& sink) noexcept
+{
+  MappedFile{std::move(sink)}.swap(*this);
+  return *this;
+}
+
+MappedFile::~MappedFile ()
+{
+  unmap();
+  if (_fd >= 0) {
+    ::close(_fd);
+  }
+}
+
+void MappedFile::resize (std::size_t newSize)
+{
+  if (!isWritable()) {
+    errno = EBADF;
+    throwSystemError("cannot resize read-only mapping of", _path);
+  }
+
+  unmap();
+  if (::ftruncate(_fd, static_cast<off_t>(newSize)) != 0) {
+    const int error = errno;
+    map();
+    errno = error;
+    throwSystemError("cannot resize", _path);
+  }
+  _size = newSize;
+  map();
+}
+
+void MappedFile::sync ()
+{
+  if (_data != nullptr && isWritable() && ::msync(_data, _size, MS_SYNC) != 0) {
+    throwSystemError("cannot sync", _path);
+  }
+}
+
+void MappedFile::close ()
+{
+  unmap();
+  const int fd = _fd;
+  _fd   = -1;
+  _size = 0;
+  if (fd >= 0 && ::close(fd) != 0) {
+    throwSystemError("cannot close", _path);
+  }
+}
+
+void MappedFile::map ()
+{
+  if (_size == 0) {
+    return;
+  }
+
+  const int protection = isWritable() ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* address = ::mmap(nullptr, _size, protection, MAP_SHARED, _fd, 0);
+  if (address == MAP_FAILED) {
+    throwSystemError("cannot map", _path);
+  }
+  _data = static_cast<unsigned char*>(address);
+}
+
+void MappedFile::unmap ()
+{
+  if (_data != nullptr) {
+    ::munmap(_data, _size);
+    _data = nullptr;
+  }
+}
+
+void MappedFile::swap (MappedFile& other) noexcept
+{
+  std::swap(_path, other._path);
+  std::swap(_mode, other._mode);
+  std::swap(_fd,   other._fd);
+  std::swap(_data, other._data);
+  std::swap(_size, other._size);
+}
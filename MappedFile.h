@@ -0,0 +1,70 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+#include <string>
+
+//
+// A file mapped into memory (POSIX mmap), shared with the file so
+// that writes through data() reach it.
+//
+// ReadOnly and ReadWrite open an existing file; Create creates the
+// file, or truncates it if it exists, and maps it read-write.  Errors
+// from the system calls are thrown as std::system_error.  A
+// zero-length file has no mapping and data() is null.
+//
+class MappedFile
+{
+public:
+  enum class Mode { ReadOnly, ReadWrite, Create };
+
+  MappedFile () = default;
+  MappedFile (const std::string& path, Mode mode);
+  MappedFile (const MappedFile& orig)            = delete;
+  MappedFile (MappedFile&& sink) noexcept;
+  MappedFile& operator= (const MappedFile& orig) = delete;
+  MappedFile& operator= (MappedFile&& sink) noexcept;
+  ~MappedFile ();
+
+  bool isOpen () const
+  { return _fd >= 0; }
+
+  bool isWritable () const
+  { return _mode != Mode::ReadOnly; }
+
+  const std::string& getPath () const
+  { return _path; }
+
+  unsigned char* data ()
+  { return _data; }
+
+  const unsigned char* data () const
+  { return _data; }
+
+  std::size_t size () const
+  { return _size; }
+
+  //
+  // Changes the length of the file and remaps it, so pointers into
+  // data() are invalidated.  Only for writable files.
+  //
+  void resize (std::size_t newSize);
+
+  // Flush the mapped pages to the file.
+  void sync ();
+
+  void close ();
+
+private:
+  void map ();
+  void unmap ();
+  void swap (MappedFile& other) noexcept;
+
+  std::string    _path;
+  Mode           _mode = Mode::ReadOnly;
+  int            _fd   = -1;
+  unsigned char* _data = nullptr;
+  std::size_t    _size = 0;
+};
+
+#endif // __MAPPED_FILE_H__
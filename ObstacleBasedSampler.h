@@ -0,0 +1,199 @@
+#ifndef __OBSTACLE_BASED_SAMPLER_H__
+#define __OBSTACLE_BASED_SAMPLER_H__
+
+#include "BatchValidity.h"
+#include "RandomNumberGenerator.h"
+#include "SampleBatch.h"
+#include "SpaceHandle.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace Samplers
+{
+  //
+  // Obstacle-based sampling (Amato et al.'s OBPRM, as in OMPL's
+  // ObstacleBasedValidStateSampler): find one valid and one invalid
+  // uniform sample, then walk along the segment between them towards
+  // the obstacle, returning a valid state within resolution of its
+  // boundary.  The walk bisects the segment, so it takes about
+  // log2(distance/resolution) validity checks.
+  //
+  // Uniform candidates are drawn kBatchSize at a time into scratch
+  // states (see SampleBatch) and checked in order only until one valid
+  // and one invalid state have been seen (batch-capable checkers, see
+  // OmplBatchValidityChecker, check a whole batch in one call).  The
+  // bisection checks one state at a time.  As with the other
+  // validating samplers, give each thread its own sampler.
+  //
+  template<typename ValidatorType>
+  class ObstacleBasedSampler
+  {
+  public:
+    typedef typename ValidatorType::SpaceType SpaceType;
+    typedef typename ValidatorType::StateType StateType;
+
+    static constexpr std::size_t kBatchSize = 64;
+
+    ObstacleBasedSampler (const ValidatorType& validator, SpaceHandle<SpaceType> spSpace, double resolution)
+      : _validator(validator)
+      , _spSpace(std::move(spSpace))
+      , _resolution(resolution)
+      , _validState(_spSpace->makeState())
+      , _invalidState(_spSpace->makeState())
+      , _midState(_spSpace->makeState())
+    { }
+
+    ObstacleBasedSampler (const ValidatorType& validator, SpaceHandle<SpaceType> spSpace, double resolution,
+                          const RandomNumberGenerator& rng)
+      : _validator(validator)
+      , _spSpace(std::move(spSpace))
+      , _resolution(resolution)
+      , _rng(rng)
+      , _validState(_spSpace->makeState())
+      , _invalidState(_spSpace->makeState())
+      , _midState(_spSpace->makeState())
+    { }
+
+    ObstacleBasedSampler (const ValidatorType& validator, SpaceType space, double resolution)
+      : ObstacleBasedSampler(validator, makeSpaceHandle(std::move(space)), resolution)
+    { }
+
+    ObstacleBasedSampler (const ValidatorType& validator, SpaceType space, double resolution,
+                          const RandomNumberGenerator& rng)
+      : ObstacleBasedSampler(validator, makeSpaceHandle(std::move(space)), resolution, rng)
+    { }
+
+    ObstacleBasedSampler (const ObstacleBasedSampler& orig)            = default;
+    ObstacleBasedSampler (ObstacleBasedSampler&& sink)                 = default;
+    ObstacleBasedSampler& operator= (const ObstacleBasedSampler& orig) = default;
+    ObstacleBasedSampler& operator= (ObstacleBasedSampler&& sink)      = default;
+    ~ObstacleBasedSampler ()                                           = default;
+
+    const SpaceHandle<SpaceType>& getSpace () const
+    { return _spSpace; }
+
+    const ValidatorType& getValidator () const
+    { return _validator; }
+
+    void setValidator (const ValidatorType& validator)
+    { _validator = validator; }
+
+    //
+    // The number of uniform samples sample() draws while looking for a
+    // valid and an invalid one before giving up and returning false.
+    // 0, the default, means it never gives up.
+    //
+    void setMaxAttempts (std::size_t maxAttempts)
+    { _maxAttempts = maxAttempts; }
+
+    std::size_t getMaxAttempts () const
+    { return _maxAttempts; }
+
+    //
+    // The single-argument form draws from the sampler's own stream;
+    // the other draws from the given one.  outState is left unchanged
+    // if no sample is found.
+    //
+    bool sample (StateType& outState) const;
+    bool sample (StateType& outState, RandomNumberGenerator& rng) const;
+
+  private:
+    // Bounds the walk if resolution is too small for the space's
+    // distance to ever get below it.
+    static constexpr int kMaxBisections = 64;
+
+    bool findEndpoints (RandomNumberGenerator& rng) const;
+
+    ValidatorType                 _validator;
+    SpaceHandle<SpaceType>        _spSpace;
+    double                        _resolution;
+    std::size_t                   _maxAttempts = 0;
+    mutable RandomNumberGenerator _rng;
+
+    // Scratch: the uniform candidates, and the ends and midpoint of
+    // the segment being bisected.
+    mutable SampleBatch<SpaceType> _candidates;
+    mutable StateType              _validState;
+    mutable StateType              _invalidState;
+    mutable StateType              _midState;
+  };
+
+  template<typename ValidatorType>
+  bool ObstacleBasedSampler<ValidatorType>::sample (StateType& outState) const
+  { return sample(outState, _rng); }
+
+  template<typename ValidatorType>
+  bool ObstacleBasedSampler<ValidatorType>::sample (StateType& outState, RandomNumberGenerator& rng) const
+  {
+    if (!findEndpoints(rng)) {
+      return false;
+    }
+
+    using std::swap;
+    for (int bisections = 0;
+         bisections < kMaxBisections && _spSpace->distance(_validState, _invalidState) > _resolution;
+         ++bisections) {
+      _spSpace->interpolate(_validState, _invalidState, 0.5, _midState);
+      swap(_validator.isValid(_midState) ? _validState : _invalidState, _midState);
+    }
+
+    outState = _validState;
+    return true;
+  }
+
+  //
+  // Sets _validState and _invalidState to the first valid and the
+  // first invalid candidate drawn.
+  //
+  template<typename ValidatorType>
+  bool ObstacleBasedSampler<ValidatorType>::findEndpoints (RandomNumberGenerator& rng) const
+  {
+    _candidates.allocate(*_spSpace, kBatchSize);
+
+    bool foundValid   = false;
+    bool foundInvalid = false;
+    std::size_t attempts = 0;
+    while (_maxAttempts == 0 || attempts < _maxAttempts) {
+      std::size_t numStates = kBatchSize;
+      if (_maxAttempts != 0 && _maxAttempts - attempts < numStates) {
+        numStates = _maxAttempts - attempts;
+      }
+      _candidates.sampleUniform(*_spSpace, numStates, rng);
+      attempts += numStates;
+
+      std::uint64_t validMask[getValidMaskWords(kBatchSize)];
+      if constexpr (OmplBatchValidityChecker<ValidatorType>()) {
+        _validator.isValidMany(_candidates.data(), numStates, validMask, false);
+      }
+
+      for (std::size_t idx = 0; idx < numStates; ++idx) {
+        bool isValid;
+        if constexpr (OmplBatchValidityChecker<ValidatorType>()) {
+          isValid = isValidMaskBitSet(validMask, idx);
+        }
+        else {
+          isValid = _validator.isValid(_candidates[idx]);
+        }
+        if (isValid) {
+          if (!foundValid) {
+            _validState = _candidates[idx];
+            foundValid  = true;
+          }
+        }
+        else if (!foundInvalid) {
+          _invalidState = _candidates[idx];
+          foundInvalid  = true;
+        }
+        if (foundValid && foundInvalid) {
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+}
+
+#endif // __OBSTACLE_BASED_SAMPLER_H__
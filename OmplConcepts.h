@@ -1,6 +1,11 @@
 #ifndef __OMPL_CONCEPTS_H__
 #define __OMPL_CONCEPTS_H__
 
+#include "RandomNumberGenerator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
 #include <type_traits>
 
 template <class T>
@@ -46,4 +51,105 @@ concept bool OmplSpace () {
   return OmplHasStateTypeTypedef<Type>();
 }
 
+//
+// Spaces with pointer-array batch kernels, i.e. ones that can process
+// states which are not stored contiguously (such as one subspace's
+// substates across many compound states) in a single call.  Generic
+// code uses them when available and falls back to per-state calls.
+//
+
+template <class Type>
+concept bool OmplBatchSamplingSpace () {
+  return requires(const Type&                             space,
+                  const typename Type::StateType* const*  states,
+                  typename Type::StateType* const*        outStates,
+                  std::size_t                             numStates,
+                  double                                  distance,
+                  RandomNumberGenerator&                  rng) {
+    space.sampleUniformMany(outStates, numStates, rng);
+    space.sampleUniformNearMany(states, distance, outStates, numStates, rng);
+    space.sampleGaussianNearMany(states, distance, outStates, numStates, rng);
+  };
+}
+
+template <class Type>
+concept bool OmplBatchMetricSpace () {
+  return requires(const Type&                             space,
+                  const typename Type::StateType&         state,
+                  const typename Type::StateType* const*  states,
+                  typename Type::StateType* const*        outStates,
+                  std::size_t                             numStates,
+                  double                                  tt,
+                  double*                                 outDistances) {
+    space.distanceMany(state, states, numStates, outDistances);
+    space.interpolateMany(states, states, numStates, tt, outStates);
+  };
+}
+
+//
+// Spaces that can write their states to, and read them from, a fixed
+// number of bytes.  The schema string describes the byte layout so
+// that stored states can be checked against the space reading them.
+//
+
+template <class Type>
+concept bool OmplSerializableSpace () {
+  return requires(const Type&                      space,
+                  const typename Type::StateType&  state,
+                  typename Type::StateType&        outState,
+                  std::string&                     schema,
+                  const unsigned char*             bytes,
+                  unsigned char*                   outBytes) {
+    space.appendSchema(schema);
+    { space.getSerializationSize() } -> std::size_t;
+    space.serialize(state, outBytes);
+    space.deserialize(bytes, outState);
+  };
+}
+
+//
+// Validity checkers that check a contiguous array of states in one
+// call (see BatchValidity.h for the mask layout and a helper that
+// falls back to per-state isValid calls).
+//
+
+template <class Type>
+concept bool OmplBatchValidityChecker () {
+  return requires(const Type&                      checker,
+                  const typename Type::StateType*  states,
+                  std::size_t                      numStates,
+                  std::uint64_t*                   outValidMask,
+                  bool                             stopAtFirstInvalid) {
+    { checker.isValidMany(states, numStates, outValidMask, stopAtFirstInvalid) } -> std::size_t;
+  };
+}
+
+//
+// Samplers that only return states their own validity checker has
+// accepted, and that can be told to give up (sample() returns false)
+// after a number of attempts.
+//
+
+template <class Type>
+concept bool OmplValidatingSampler () {
+  return requires(Type& sampler, std::size_t maxAttempts) {
+    sampler.getValidator();
+    { sampler.getMaxAttempts() } -> std::size_t;
+    sampler.setMaxAttempts(maxAttempts);
+  };
+}
+
+//
+// Validity checkers whose answers are drawn from a stream of their
+// own, which can be replaced so that copies of a checker used side by
+// side do not give the same answers.
+//
+
+template <class Type>
+concept bool OmplRandomizedValidityChecker () {
+  return requires(Type& checker, const RandomNumberGenerator& rng) {
+    checker.setRandomNumberGenerator(rng);
+  };
+}
+
 #endif // __OMPL_CONCEPTS_H__
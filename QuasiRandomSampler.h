@@ -0,0 +1,69 @@
+#ifndef __QUASI_RANDOM_SAMPLER_H__
+#define __QUASI_RANDOM_SAMPLER_H__
+
+#include "HaltonSequence.h"
+#include "RandomNumberGenerator.h"
+#include "SpaceHandle.h"
+
+#include <utility>
+#include <vector>
+
+namespace Samplers
+{
+  //
+  // Low-discrepancy counterpart of SpaceType::sampleUniform.
+  //
+  // Points of a randomized Halton sequence with one coordinate per
+  // degree of freedom are mapped into the space by its
+  // sampleFromUnitCube, which hands each subspace of a compound space
+  // its own slice of the coordinates.
+  //
+  template<typename SpaceType>
+  class QuasiRandomSampler
+  {
+  public:
+    explicit QuasiRandomSampler (SpaceHandle<SpaceType> spSpace)
+      : QuasiRandomSampler(std::move(spSpace), RandomNumberGenerator{})
+    { }
+
+    QuasiRandomSampler (SpaceHandle<SpaceType> spSpace, RandomNumberGenerator rng)
+      : _spSpace(std::move(spSpace))
+      , _sequence(_spSpace->getDimension(), rng)
+      , _point(_spSpace->getDimension())
+    { }
+
+    explicit QuasiRandomSampler (SpaceType space)
+      : QuasiRandomSampler(makeSpaceHandle(std::move(space)))
+    { }
+
+    QuasiRandomSampler (SpaceType space, RandomNumberGenerator rng)
+      : QuasiRandomSampler(makeSpaceHandle(std::move(space)), rng)
+    { }
+
+    QuasiRandomSampler (const QuasiRandomSampler<SpaceType>& orig)            = default;
+    QuasiRandomSampler (QuasiRandomSampler<SpaceType>&& sink)                 = default;
+    QuasiRandomSampler& operator= (const QuasiRandomSampler<SpaceType>& orig) = default;
+    QuasiRandomSampler& operator= (QuasiRandomSampler<SpaceType>&& sink)      = default;
+    ~QuasiRandomSampler ()                                                    = default;
+
+    const SpaceHandle<SpaceType>& getSpace () const
+    { return _spSpace; }
+
+    bool sample (typename SpaceType::StateType& outState) const;
+
+  private:
+    SpaceHandle<SpaceType>      _spSpace;
+    mutable HaltonSequence      _sequence;
+    mutable std::vector<double> _point;
+  };
+
+  template<typename SpaceType>
+  bool QuasiRandomSampler<SpaceType>::sample (typename SpaceType::StateType& outState) const
+  {
+    _sequence.next(_point.data());
+    _spSpace->sampleFromUnitCube(_point.data(), outState);
+    return true;
+  }
+}
+
+#endif // __QUASI_RANDOM_SAMPLER_H__
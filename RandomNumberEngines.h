@@ -0,0 +1,315 @@
+#ifndef __RANDOM_NUMBER_ENGINES_H__
+#define __RANDOM_NUMBER_ENGINES_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <variant>
+
+//
+// Compact 64-bit engines for use with BasicRandomNumberGenerator.
+//
+// Each engine models UniformRandomBitGenerator over the full
+// 64-bit range and can be constructed from a single 64-bit seed.
+// Seeds are expanded into the full engine state with SplitMix64,
+// so nearby seeds still produce unrelated streams.
+//
+
+class SplitMix64
+{
+public:
+  typedef std::uint64_t result_type;
+
+  explicit SplitMix64 (std::uint64_t seed=0)
+    : _state{seed}
+  { }
+
+  static constexpr result_type min () { return 0; }
+  static constexpr result_type max () { return std::numeric_limits<result_type>::max(); }
+
+  result_type operator() ()
+  {
+    std::uint64_t zz = (_state += 0x9E3779B97F4A7C15ULL);
+    zz = (zz ^ (zz >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    zz = (zz ^ (zz >> 27)) * 0x94D049BB133111EBULL;
+    return zz ^ (zz >> 31);
+  }
+
+private:
+  std::uint64_t _state;
+};
+
+//
+// xoshiro256++ (Blackman and Vigna): 32 bytes of state,
+// period 2^256 - 1, and only a handful of ALU ops per draw.
+//
+class Xoshiro256PlusPlus
+{
+public:
+  typedef std::uint64_t result_type;
+
+  explicit Xoshiro256PlusPlus (std::uint64_t seed=0)
+  {
+    SplitMix64 seeder{seed};
+    for (auto& word : _state) {
+      word = seeder();
+    }
+  }
+
+  static constexpr result_type min () { return 0; }
+  static constexpr result_type max () { return std::numeric_limits<result_type>::max(); }
+
+  result_type operator() ()
+  {
+    const std::uint64_t result = rotl(_state[0] + _state[3], 23) + _state[0];
+    const std::uint64_t tt     = _state[1] << 17;
+
+    _state[2] ^= _state[0];
+    _state[3] ^= _state[1];
+    _state[1] ^= _state[2];
+    _state[0] ^= _state[3];
+    _state[2] ^= tt;
+    _state[3]  = rotl(_state[3], 45);
+
+    return result;
+  }
+
+  //
+  // Advance by 2^128 draws.  Successive jumps hand out
+  // non-overlapping subsequences of the full period.
+  //
+  void jump ()
+  {
+    static constexpr std::uint64_t kJump[] = { 0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+                                               0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL };
+    std::uint64_t jumped[4] = { 0, 0, 0, 0 };
+    for (std::uint64_t word : kJump) {
+      for (int bit = 0; bit < 64; ++bit) {
+        if (word & (std::uint64_t{1} << bit)) {
+          for (int idx = 0; idx < 4; ++idx) {
+            jumped[idx] ^= _state[idx];
+          }
+        }
+        (*this)();
+      }
+    }
+    for (int idx = 0; idx < 4; ++idx) {
+      _state[idx] = jumped[idx];
+    }
+  }
+
+private:
+  static std::uint64_t rotl (std::uint64_t xx, int kk)
+  { return (xx << kk) | (xx >> (64 - kk)); }
+
+  std::uint64_t _state[4];
+};
+
+//
+// PCG64 (O'Neill, XSL-RR output on a 128-bit LCG): 32 bytes of state,
+// period 2^128.
+//
+class Pcg64
+{
+public:
+  typedef std::uint64_t result_type;
+
+  explicit Pcg64 (std::uint64_t seed=0)
+  {
+    SplitMix64 seeder{seed};
+    std::uint64_t stateHigh = seeder();
+    std::uint64_t stateLow  = seeder();
+
+    _state = 0;
+    step();
+    _state += (static_cast<uint128>(stateHigh) << 64) | stateLow;
+    step();
+  }
+
+  static constexpr result_type min () { return 0; }
+  static constexpr result_type max () { return std::numeric_limits<result_type>::max(); }
+
+  result_type operator() ()
+  {
+    step();
+    const std::uint64_t xorShifted = static_cast<std::uint64_t>(_state >> 64) ^ static_cast<std::uint64_t>(_state);
+    const unsigned int  rotation   = static_cast<unsigned int>(_state >> 122);
+    return (xorShifted >> rotation) | (xorShifted << ((64 - rotation) & 63));
+  }
+
+  //
+  // Advance by 2^64 draws using the O(log n) LCG jump-ahead.
+  //
+  void jump ()
+  { advance(static_cast<uint128>(1) << 64); }
+
+private:
+  typedef unsigned __int128 uint128;
+
+  void advance (uint128 delta)
+  {
+    uint128 accMultiplier = 1;
+    uint128 accIncrement  = 0;
+    uint128 curMultiplier = kMultiplier;
+    uint128 curIncrement  = kIncrement;
+    while (delta > 0) {
+      if (delta & 1) {
+        accMultiplier *= curMultiplier;
+        accIncrement   = accIncrement*curMultiplier + curIncrement;
+      }
+      curIncrement   = (curMultiplier + 1)*curIncrement;
+      curMultiplier *= curMultiplier;
+      delta >>= 1;
+    }
+    _state = accMultiplier*_state + accIncrement;
+  }
+
+  static constexpr uint128 kMultiplier = (static_cast<uint128>(0x2360ED051FC65DA4ULL) << 64) | 0x4385DF649FCCF645ULL;
+  static constexpr uint128 kIncrement  = (static_cast<uint128>(0x5851F42D4C957F2DULL) << 64) | 0x14057B7EF767814FULL;
+
+  void step ()
+  { _state = _state*kMultiplier + kIncrement; }
+
+  uint128 _state;
+};
+
+//
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+// 1, 2, 3"): a counter-based generator whose output is a keyed bijection
+// of a 128-bit counter.  The key comes from the seed, the upper half of
+// the counter selects a stream and the lower half is the position within
+// it, so stream N of a given seed can be constructed directly in O(1)
+// and is identical no matter which thread asks for it.
+//
+class Philox4x32
+{
+public:
+  typedef std::uint64_t result_type;
+
+  explicit Philox4x32 (std::uint64_t seed=0, std::uint64_t stream=0)
+    : _key{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)}
+    , _stream{stream}
+    , _block{0}
+    , _bufferIdx{2}
+  { }
+
+  static constexpr result_type min () { return 0; }
+  static constexpr result_type max () { return std::numeric_limits<result_type>::max(); }
+
+  result_type operator() ()
+  {
+    if (_bufferIdx == 2) {
+      generateBlock();
+    }
+    return _buffer[_bufferIdx++];
+  }
+
+  //
+  // Move to the start of the next stream.
+  //
+  void jump ()
+  {
+    ++_stream;
+    _block     = 0;
+    _bufferIdx = 2;
+  }
+
+  std::uint64_t getStream () const
+  { return _stream; }
+
+private:
+  static void mulhilo (std::uint32_t aa, std::uint32_t bb, std::uint32_t& hi, std::uint32_t& lo)
+  {
+    const std::uint64_t product = static_cast<std::uint64_t>(aa)*bb;
+    hi = static_cast<std::uint32_t>(product >> 32);
+    lo = static_cast<std::uint32_t>(product);
+  }
+
+  void generateBlock ()
+  {
+    std::uint32_t ctr[4] = { static_cast<std::uint32_t>(_block),  static_cast<std::uint32_t>(_block >> 32),
+                             static_cast<std::uint32_t>(_stream), static_cast<std::uint32_t>(_stream >> 32) };
+    std::uint32_t key[2] = { _key[0], _key[1] };
+
+    for (int round = 0; round < 10; ++round) {
+      std::uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(0xD2511F53U, ctr[0], hi0, lo0);
+      mulhilo(0xCD9E8D57U, ctr[2], hi1, lo1);
+      ctr[0] = hi1 ^ ctr[1] ^ key[0];
+      ctr[1] = lo1;
+      ctr[2] = hi0 ^ ctr[3] ^ key[1];
+      ctr[3] = lo0;
+      key[0] += 0x9E3779B9U;
+      key[1] += 0xBB67AE85U;
+    }
+
+    _buffer[0] = (static_cast<std::uint64_t>(ctr[1]) << 32) | ctr[0];
+    _buffer[1] = (static_cast<std::uint64_t>(ctr[3]) << 32) | ctr[2];
+    ++_block;
+    _bufferIdx = 0;
+  }
+
+  std::uint32_t _key[2];
+  std::uint64_t _stream;
+  std::uint64_t _block;
+  std::uint64_t _buffer[2];
+  unsigned int  _bufferIdx;
+};
+
+//
+// One of the engines above, chosen at run time.
+//
+// This is the engine of RandomNumberGenerator, the stream type that
+// spaces and samplers take, so they accept a stream from any engine
+// without being templates themselves.  A single draw dispatches on the
+// engine through std::visit (an indirect call that is always predicted
+// the same way); fill() dispatches once for a whole block of draws.
+// With xoshiro256++ that costs a few tenths of a nanosecond on a scalar
+// draw of about two and nothing measurable on bulk draws, against tens
+// of nanoseconds for a sample from a space; code that must avoid even
+// that can use a typed generator.  Seeding alone selects xoshiro256++.
+//
+class AnyEngine
+{
+public:
+  typedef std::uint64_t result_type;
+
+  explicit AnyEngine (std::uint64_t seed=0)
+    : _engine{Xoshiro256PlusPlus{seed}}
+  { }
+
+  AnyEngine (const Xoshiro256PlusPlus& engine)
+    : _engine{engine}
+  { }
+
+  AnyEngine (const Pcg64& engine)
+    : _engine{engine}
+  { }
+
+  AnyEngine (const Philox4x32& engine)
+    : _engine{engine}
+  { }
+
+  static constexpr result_type min () { return 0; }
+  static constexpr result_type max () { return std::numeric_limits<result_type>::max(); }
+
+  result_type operator() ()
+  { return std::visit([] (auto& engine) { return engine(); }, _engine); }
+
+  void fill (std::uint64_t* bits, std::size_t count)
+  {
+    std::visit([bits, count] (auto& engine) {
+        for (std::size_t idx = 0; idx < count; ++idx) {
+          bits[idx] = engine();
+        }
+      }, _engine);
+  }
+
+  void jump ()
+  { std::visit([] (auto& engine) { engine.jump(); }, _engine); }
+
+private:
+  std::variant<Xoshiro256PlusPlus, Pcg64, Philox4x32> _engine;
+};
+
+#endif // __RANDOM_NUMBER_ENGINES_H__
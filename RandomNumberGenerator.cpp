@@ -1,65 +1,216 @@
 #include "RandomNumberGenerator.h"
 
-#include <boost/math/constants/constants.hpp>
-using namespace boost::math::double_constants;
+#include <cmath>
 
-RandomNumberGenerator::RandomNumberGenerator ()
-  : _generator{std::random_device{}()}
-  , _uniformRealDist_0_1{0.0, 1.0}
-  , _uniformRealDist_negPi_pi{-pi, +pi}
-  , _normalRealDist_0_1{0.0, 1.0}
-{ }
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-RandomNumberGenerator::RandomNumberGenerator (std::random_device::result_type seed)
-  : _generator{seed}
-  , _uniformRealDist_0_1{0.0, 1.0}
-  , _uniformRealDist_negPi_pi{-pi, +pi}
-  , _normalRealDist_0_1{0.0, 1.0}
-{ }
-
-RandomNumberGenerator::RandomNumberGenerator (const RandomNumberGenerator& orig)
-  : _generator{orig._generator}
-  , _uniformRealDist_0_1{orig._uniformRealDist_0_1}
-  , _uniformRealDist_negPi_pi{orig._uniformRealDist_negPi_pi}
-  , _normalRealDist_0_1{orig._normalRealDist_0_1}
-{ }
-
-RandomNumberGenerator& RandomNumberGenerator::operator= (const RandomNumberGenerator& orig)
+namespace RandomKernels
 {
-  _generator                = orig._generator;
-  _uniformRealDist_0_1      = orig._uniformRealDist_0_1;
-  _uniformRealDist_negPi_pi = orig._uniformRealDist_negPi_pi;
-  _normalRealDist_0_1       = orig._normalRealDist_0_1;
+  //
+  // Convert raw 64-bit words to doubles in [lower, lower+scale).
+  //
+  // The top 52 bits of each word become the mantissa of a double
+  // in [1,2), which is then shifted down to [0,1) and scaled.  This
+  // avoids integer-to-double conversions, which AVX2 lacks for
+  // 64-bit lanes.
+  //
+  void scaleBits (const std::uint64_t* bits, double lower, double scale, double* out, std::size_t count)
+  {
+    std::size_t idx = 0;
 
-  return *this;
-}
+#if defined(__AVX2__)
+    const __m256i exponent = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    const __m256d one      = _mm256_set1_pd(1.0);
+    const __m256d vLower   = _mm256_set1_pd(lower);
+    const __m256d vScale   = _mm256_set1_pd(scale);
+    for (; idx + 4 <= count; idx += 4) {
+      __m256i word = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bits + idx));
+      word = _mm256_or_si256(_mm256_srli_epi64(word, 12), exponent);
+      __m256d unit = _mm256_sub_pd(_mm256_castsi256_pd(word), one);
+      _mm256_storeu_pd(out + idx, _mm256_add_pd(vLower, _mm256_mul_pd(vScale, unit)));
+    }
+#elif defined(__SSE2__)
+    const __m128i exponent = _mm_set1_epi64x(0x3FF0000000000000LL);
+    const __m128d one      = _mm_set1_pd(1.0);
+    const __m128d vLower   = _mm_set1_pd(lower);
+    const __m128d vScale   = _mm_set1_pd(scale);
+    for (; idx + 2 <= count; idx += 2) {
+      __m128i word = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + idx));
+      word = _mm_or_si128(_mm_srli_epi64(word, 12), exponent);
+      __m128d unit = _mm_sub_pd(_mm_castsi128_pd(word), one);
+      _mm_storeu_pd(out + idx, _mm_add_pd(vLower, _mm_mul_pd(vScale, unit)));
+    }
+#endif
 
-double RandomNumberGenerator::realUniform (double lower, double upper)
-{ return lower + (upper - lower)*_uniformRealDist_0_1(_generator); }
+    for (; idx < count; ++idx) {
+      std::uint64_t word = (bits[idx] >> 12) | 0x3FF0000000000000ULL;
+      double unit;
+      std::memcpy(&unit, &word, sizeof(unit));
+      out[idx] = lower + scale*(unit - 1.0);
+    }
+  }
 
-double RandomNumberGenerator::realUniform_0_1 ()
-{ return _uniformRealDist_0_1(_generator); }
+  //
+  // Generated with kZigguratV = 0.00492867323399 (the common layer area):
+  //   zigguratX[0]   = kZigguratV / f(kZigguratR),   zigguratX[1] = kZigguratR,
+  //   zigguratX[i]   = sqrt(-2 log(kZigguratV / zigguratX[i-1] + f(zigguratX[i-1]))),
+  //   zigguratX[256] = 0,
+  // where f(x) = exp(-x^2/2).  They are literals rather than computed at
+  // startup so that they are usable during static initialization.
+  //
+  const double zigguratX[kZigguratLayers + 1] = {
+    3.91075795953709, 3.6541528853610088, 3.4492782985609645, 3.3202447338391661,
+    3.2245750520470291, 3.14788928951715, 3.083526132001233, 3.0278377917686354,
+    2.9786032798808448, 2.9343668672078542, 2.8941210536123481, 2.8571387308721325,
+    2.8228773968253251, 2.7909211740007858, 2.7609440052788226, 2.7326853590428271,
+    2.7059336561218581, 2.6805146432845222, 2.6562830375755024, 2.6331163936303246,
+    2.6109105184875485, 2.5895759867069952, 2.5690354526805366, 2.5492215503234608,
+    2.5300752321585169, 2.5115444416253423, 2.4935830412696807, 2.4761499396691433,
+    2.4592083743333113, 2.4427253181989568, 2.426670984935726, 2.4110184138996855,
+    2.3957431197804806, 2.380822795170626, 2.3662370567158186, 2.35196722737766,
+    2.3379961487950314, 2.324308018869623, 2.31088825059985, 2.2977233489013296,
+    2.2848008027229461, 2.2721089902268239, 2.2596370951722178, 2.2473750329458078,
+    2.235313384928328, 2.2234433400909057, 2.2117566428825444, 2.200245546609648,
+    2.1889027716247207, 2.1777214677386416, 2.166695180352646, 2.1558178198750633,
+    2.1450836340462036, 2.1344871828443202, 2.1240233156878157, 2.113687150684934,
+    2.1034740557131468, 2.0933796311370503, 2.0833996939965518, 2.0735302635169788,
+    2.0637675478099564, 2.0541079316488648, 2.0445479652157328, 2.0350843537278087,
+    2.025713947862033, 2.0164337349043717, 2.0072408305586849, 1.9981324713565642,
+    1.9891060076155713, 1.9801588968985984, 1.9712886979317696, 1.9624930649424619,
+    1.953769742382734, 1.9451165600067539, 1.9365314282737589, 1.9280123340507183,
+    1.9195573365912288, 1.9111645637692822, 1.9028322085484464, 1.8945585256687101,
+    1.8863418285347764, 1.8781804862909777, 1.8700729210692368, 1.8620176053976323,
+    1.8540130597581481, 1.8460578502831198, 1.8381505865807286, 1.8302899196806666,
+    1.8224745400917832, 1.8147031759641676, 1.8069745913486934, 1.7992875845475802,
+    1.79164098655001, 1.7840336595472763, 1.776464495522345, 1.7689324149090779,
+    1.7614363653167067, 1.7539753203154551, 1.746548278279493, 1.739154261283669,
+    1.7317923140507072, 1.7244615029457757, 1.7171609150155407, 1.7098896570690061,
+    1.7026468547976139, 1.6954316519322385, 1.6882432094348587, 1.6810807047228233,
+    1.6739433309237604, 1.6668302961592867, 1.6597408228557895, 1.6526741470806485,
+    1.6456295179023603, 1.6386061967731111, 1.631603456932422, 1.6246205828305684,
+    1.6176568695705342, 1.6107116223673337, 1.603784156023583, 1.5968737944202613,
+    1.5899798700216485, 1.5831017233934714, 1.5762387027333329, 1.5693901634125345,
+    1.5625554675284397, 1.5557339834665549, 1.5489250854715355, 1.5421281532263476,
+    1.5353425714388431, 1.5285677294350246, 1.5218030207582931, 1.5150478427739924,
+    1.508301596278572, 1.5015636851127065, 1.4948335157777184, 1.4881104970546544,
+    1.4813940396253757, 1.4746835556950255, 1.4679784586152309, 1.4612781625074078,
+    1.4545820818855233, 1.4478896312776697, 1.441200224845798, 1.4345132760029464,
+    1.4278281970272904, 1.4211443986723231, 1.4144612897724647, 1.4077782768433715,
+    1.4010947636762026, 1.3944101509250713, 1.3877238356868846, 1.381035211072742,
+    1.3743436657700305, 1.367648583594318, 1.3609493430301018, 1.3542453167594306,
+    1.3475358711773593, 1.3408203658931521, 1.3340981532160836, 1.3273685776246247,
+    1.3206309752177301, 1.313884673146869, 1.3071289890273539, 1.3003632303274337,
+    1.2935866937335176, 1.2867986644897864, 1.2799984157103332, 1.2731852076618437,
+    1.2663582870146883, 1.2595168860601442, 1.2526602218912979, 1.2457874955449979,
+    1.2388978911020274, 1.2319905747424451, 1.225064693752808, 1.2181193754817266,
+    1.2111537262399112, 1.2041668301405601, 1.1971577478755859, 1.1901255154228016,
+    1.1830691426787607, 1.1759876120114898, 1.1688798767268338, 1.1617448594415742,
+    1.1545814503558518, 1.1473885054167339, 1.1401648443639958, 1.132909248648337,
+    1.1256204592112944, 1.1182971741150629, 1.1109380460092495, 1.1035416794202682,
+    1.0961066278476035, 1.0886313906495142, 1.0811144096988894, 1.0735540657878717,
+    1.0659486747575067, 1.0582964833260065, 1.0505956645862071, 1.0428443131393705,
+    1.0350404398286053, 1.0271819660307513, 1.0192667174605292, 1.0112924174349784,
+    1.0032566795395914, 0.99515699962994308, 0.98699074709384627, 0.97875515528893775,
+    0.97044731105886461, 0.96206414321760525, 0.95360240987557265, 0.94505868446257113,
+    0.93642934028089686, 0.92771053339623477, 0.91889818364373499, 0.909987953490769,
+    0.90097522445517453, 0.89185507072679238, 0.88262222957891012, 0.87327106808249455,
+    0.86379554554682692, 0.85418917100156055, 0.84444495490242366, 0.83455535407951875,
+    0.82451220874528863, 0.81430667012806435, 0.80392911698266489, 0.79336905883315278,
+    0.78261502329958876, 0.77165442421673935, 0.76047340642208316, 0.74905666200958165,
+    0.73738721142583863, 0.72544614090130355, 0.71321228518202273, 0.70066184109758445,
+    0.68776789278625772, 0.67449982282743648, 0.66082257423420598, 0.64669571488438893,
+    0.63207223637502463, 0.61689698999623555, 0.60110461774394042, 0.58461676609372226,
+    0.56733825704047303, 0.54915170231302679, 0.52990972064649511, 0.50942332958593339,
+    0.48744396612175434, 0.46363433677176324, 0.43751840218666266, 0.40838913458800075,
+    0.37512133285046573, 0.33573751918045946, 0.28617459174726051, 0.21524189591327381,
+    0
+  };
 
-double RandomNumberGenerator::realUniform_negPi_pi ()
-{ return _uniformRealDist_negPi_pi(_generator); }
+  const double zigguratRatio[kZigguratLayers] = {
+    0.93438482339457918, 0.94393376707887688, 0.96259114123217282, 0.97118595481318182,
+    0.97621833534896407, 0.97955355109525166, 0.98194004595756246, 0.98373938259782689,
+    0.98514860539777549, 0.98628466874907117, 0.98722157019173218, 0.9880085157655788,
+    0.98867955694410314, 0.98925904142287513, 0.98976486079327719, 0.99021047087164871,
+    0.99060619510022785, 0.99096009202198276, 0.99127854840110596, 0.99156669443231094,
+    0.99182870051291072, 0.99206799331940876, 0.99228741575504453, 0.99248934712539427,
+    0.99267579465715527, 0.99284846405344196, 0.99300881450025391, 0.9931581019935749,
+    0.99329741379120706, 0.99342769604768011, 0.99354977616116547, 0.99366438098060894,
+    0.9937721517442063, 0.99387365641643144, 0.99396939993917421, 0.99405983279868837,
+    0.99414535822376648, 0.99422633826462492, 0.99430309895119195, 0.99437593469006502,
+    0.99444511202858621, 0.99451087289022999, 0.99457343736628845, 0.99463300613352923,
+    0.99468976255523878, 0.99474387451317581, 0.99479549600995243, 0.99484476857485049,
+    0.99489182250074104, 0.99493677793540536, 0.99497974584693893, 0.99502082887992749,
+    0.99506012211659289, 0.99509771375503842, 0.99513368571496374, 0.99516811417977458,
+    0.9952010700827616, 0.99523261954398701, 0.99526282426362433, 0.9952917418767433,
+    0.99531942627388326, 0.99534592789120968, 0.99537129397356761, 0.99539556881334612,
+    0.99541879396769928, 0.99544100845638606, 0.99546224894220314, 0.99548254989577112,
+    0.9955019437462268, 0.99552046101920322, 0.99553813046331774, 0.9955549791662659,
+    0.99557103266149105, 0.99558631502630091, 0.99560084897220869, 0.99561465592819853,
+    0.99562775611753773, 0.99564016862870119, 0.99565191148091414, 0.99566300168476796,
+    0.99567345529832307, 0.99568328747906887, 0.9956925125320788, 0.9957011439546648,
+    0.99570919447780692, 0.99571667610460934, 0.99572360014601191, 0.99572997725396051,
+    0.99573581745222939, 0.99574113016506516, 0.99574592424380703, 0.99575020799162972,
+    0.99575398918653768, 0.9957572751027286, 0.99576007253043786, 0.99576238779435977,
+    0.99576422677074117, 0.99576559490322458, 0.99576649721752453, 0.99576693833499974,
+    0.9957669224851885, 0.99576645351736526, 0.99576553491117126, 0.99576416978636662,
+    0.99576236091175052, 0.99576011071328807, 0.99575742128147937, 0.99575429437800855,
+    0.99575073144169801, 0.99574673359379606, 0.99574230164262523, 0.99573743608760856,
+    0.99573213712269715, 0.99572640463921136, 0.99572023822811573, 0.99571363718173422,
+    0.99570660049492177, 0.99569912686569617, 0.9956912146953395, 0.99568286208797385,
+    0.99567406684961146, 0.99566482648668508, 0.99565513820405349, 0.99564499890248248,
+    0.99563440517559698, 0.99562335330629759, 0.99561183926263364, 0.99559985869312606,
+    0.99558740692152536, 0.99557447894099416, 0.99556106940769862, 0.99554717263379067,
+    0.99553278257976396, 0.99551789284616121, 0.99550249666460933, 0.99548658688815639,
+    0.99547015598088462, 0.9954531960067633, 0.9954356986177143, 0.99541765504084812,
+    0.99539905606483314, 0.99537989202535504, 0.99536015278961876, 0.99533982773984286,
+    0.99531890575569049, 0.99529737519558037, 0.99527522387681022, 0.99525243905442606,
+    0.99522900739876285, 0.9952049149715736, 0.99518014720066261, 0.99515468885292668,
+    0.99512852400570317, 0.99510163601631507, 0.99507400748969466, 0.99504562024395526,
+    0.99501645527377336, 0.99498649271142992, 0.99495571178534647, 0.99492409077593824,
+    0.99489160696859402, 0.99485823660357142, 0.99482395482258057, 0.9947887356118108,
+    0.99475255174112853, 0.99471537469915738, 0.99467717462391658, 0.9946379202286737,
+    0.99459757872262833, 0.9945561157260111, 0.99451349517914489, 0.9944696792449691,
+    0.99442462820447775, 0.99437830034447705, 0.99433065183700176, 0.99428163660966262,
+    0.99423120620613348, 0.99417930963589485, 0.99412589321226608, 0.99407090037765122,
+    0.99401427151481903, 0.99395594374289498, 0.99389585069661779, 0.99383392228723466,
+    0.99377008444324044, 0.99370425882895308, 0.99363636253869403, 0.99356630776406951,
+    0.99349400143156352, 0.99341934480730776, 0.99334223306551539, 0.99326255481662407,
+    0.9931801915906957, 0.99309501727105265, 0.99300689747246695, 0.99291568885747405,
+    0.99282123838350755, 0.99272338247255887, 0.99262194609389565, 0.99251674174904159,
+    0.99240756834664812, 0.9922942099530736, 0.99217643440235304, 0.99205399174675046,
+    0.991926612526153, 0.99179400583110655, 0.99165585713021331, 0.9915118258277571,
+    0.99136154251165642, 0.99120460584495695, 0.991040579045814, 0.99086898589098571,
+    0.99068930616585893, 0.99050097046948593, 0.99030335426539429, 0.99009577104727475,
+    0.9898774644620254, 0.98964759919976886, 0.9894052504196762, 0.9891493914295435,
+    0.98887887927323703, 0.98859243779956663, 0.98828863768385278, 0.98796587274272862,
+    0.98762233171446345, 0.98725596445898278, 0.98686444124682726, 0.98644510343095493,
+    0.98599490329659356, 0.98551033021549073, 0.98498731932492467, 0.98442113771148365,
+    0.98380624136205808, 0.98313609373663313, 0.98240293339698259, 0.98159747319601653,
+    0.98070850631734174, 0.97972238371257558, 0.97862231119118781, 0.97738738919589319,
+    0.97599127836112509, 0.97440030911418207, 0.97257074531867649, 0.97044472540755145,
+    0.96794407128065607, 0.96496053533935255, 0.96133984665242955, 0.95685442305509605,
+    0.95115412025831936, 0.94367126738941931, 0.93342161734665918, 0.91853896462966156,
+    0.89501046669157103, 0.85237596455057263, 0.75213489289562085, 0
+  };
 
-double RandomNumberGenerator::intUniform (int lower, int upper)
-{
-  int result;
-  do {
-    result = (int)floor(realUniform((double)lower, (double)(upper + 1)));
-  } while (result > upper);
-  return result;
-}
+  std::size_t zigguratFastPath (const std::uint64_t* bits, double* out, std::size_t count, std::uint32_t* slowIdx)
+  {
+    //
+    // Kept as two simple loops so that the first one
+    // vectorizes (with gathers for the table lookups).
+    //
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      out[idx] = signedUnitFromBits(bits[idx])*zigguratX[bits[idx] & 0xFF];
+    }
 
-double RandomNumberGenerator::realNormal (double mean, double stddev)
-{ return mean + stddev*_normalRealDist_0_1(_generator); }
-
-double RandomNumberGenerator::realNormal_0_1 ()
-{ return _normalRealDist_0_1(_generator); }
-
-bool RandomNumberGenerator::boolUniform ()
-{ return _uniformRealDist_0_1(_generator) <= 0.5; }
-
-bool RandomNumberGenerator::boolWithTrueBias (double probOfTrue)
-{ return _uniformRealDist_0_1(_generator) <= probOfTrue; }
+    std::size_t numSlow = 0;
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      if (!(std::fabs(signedUnitFromBits(bits[idx])) < zigguratRatio[bits[idx] & 0xFF])) {
+        slowIdx[numSlow++] = static_cast<std::uint32_t>(idx);
+      }
+    }
+    return numSlow;
+  }
+}
@@ -1,22 +1,133 @@
 #ifndef __RANDOM_NUMBER_GENERATOR_H__
 #define __RANDOM_NUMBER_GENERATOR_H__
 
+#include "RandomNumberEngines.h"
+
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <random>
+#include <type_traits>
 
-class RandomNumberGenerator
+//
+// Non-template kernels shared by every engine instantiation.
+// These are defined in RandomNumberGenerator.cpp.
+//
+namespace RandomKernels
 {
+  //
+  // Bulk requests are processed in blocks of this many raw
+  // words so that the scratch buffer stays on the stack (and in L1).
+  //
+  constexpr std::size_t kBlockSize = 256;
+
+  void scaleBits (const std::uint64_t* bits, double lower, double scale, double* out, std::size_t count);
+
+  // Map the top 53 bits of a raw word to [0,1).
+  inline double unitFromBits (std::uint64_t bits)
+  { return (bits >> 11) * 0x1.0p-53; }
+
+  // Map the top 52 bits of a raw word to [-1,1) via a double in [1,2).
+  inline double signedUnitFromBits (std::uint64_t bits)
+  {
+    std::uint64_t word = (bits >> 12) | 0x3FF0000000000000ULL;
+    double unit;
+    std::memcpy(&unit, &word, sizeof(unit));
+    return 2.0*unit - 3.0;
+  }
+
+  //
+  // 256-layer ziggurat for the standard normal (Marsaglia and Tsang,
+  // with Doornik's fix for layer/uniform correlation).  A raw word
+  // supplies the layer index (low 8 bits) and a signed uniform (top 52
+  // bits); about 99% of draws are accepted by the rectangle test alone.
+  //
+  // zigguratX[i] is the right edge of layer i (zigguratX[0] is the
+  // "virtual" width of the base strip and zigguratX[256] is 0), and
+  // zigguratRatio[i] = zigguratX[i+1]/zigguratX[i].
+  //
+  constexpr int    kZigguratLayers = 256;
+  constexpr double kZigguratR      = 3.6541528853610088;
+
+  extern const double zigguratX[kZigguratLayers + 1];
+  extern const double zigguratRatio[kZigguratLayers];
+
+  //
+  // Batch fast path: writes the rectangle-test candidate for every word
+  // into out and the indices that failed the test into slowIdx.  Returns
+  // the number of failures, which the caller must redo with the full
+  // algorithm starting from the same word.
+  //
+  std::size_t zigguratFastPath (const std::uint64_t* bits, double* out, std::size_t count, std::uint32_t* slowIdx);
+}
+
+//
+// The engine is a policy: any UniformRandomBitGenerator producing the
+// full 64-bit range and constructible from a 64-bit seed will do.
+// See RandomNumberEngines.h for the engines that ship with the tree.
+//
+// Streams.
+//
+// jump() moves this generator to the next non-overlapping stream and
+// split() hands out the current stream while moving this generator on,
+// so a parent seeded once can deterministically give every worker or
+// task its own uncorrelated generator:
+//
+//   RandomNumberGenerator root{seed};
+//   std::vector<RandomNumberGenerator> streams;
+//   for (int task = 0; task < numTasks; ++task) {
+//     streams.push_back(root.split());
+//   }
+//
+// The result depends only on the seed and the order of the split()
+// calls, not on how many threads later consume the streams.
+//
+// RandomNumberGenerator, the stream type that spaces and samplers
+// take, runs on AnyEngine, so a stream from any engine can be handed
+// to them:
+//
+//   RandomNumberGenerator rng{PhiloxRandomNumberGenerator{seed}};
+//   RandomNumberGenerator rng{Philox4x32{seed, stream}};
+//
+template <typename EngineType>
+class BasicRandomNumberGenerator
+{
+  static_assert(EngineType::min() == 0 &&
+                EngineType::max() == std::numeric_limits<std::uint64_t>::max(),
+                "BasicRandomNumberGenerator requires a full-range 64-bit engine");
+
 public:
-  RandomNumberGenerator ();
-  RandomNumberGenerator (std::random_device::result_type seed);
-  RandomNumberGenerator (const RandomNumberGenerator& orig);
-  RandomNumberGenerator& operator= (const RandomNumberGenerator& orig);
-  ~RandomNumberGenerator () = default;
+  BasicRandomNumberGenerator ();
+  BasicRandomNumberGenerator (std::random_device::result_type seed);
+  explicit BasicRandomNumberGenerator (const EngineType& engine);
+
+  // Continue other's stream with this generator's engine type.
+  template <typename OtherEngineType,
+            typename = std::enable_if_t<!std::is_same<OtherEngineType, EngineType>::value &&
+                                        std::is_constructible<EngineType, const OtherEngineType&>::value>>
+  BasicRandomNumberGenerator (const BasicRandomNumberGenerator<OtherEngineType>& other)
+    : _engine{other.getEngine()}
+  { }
+
+  BasicRandomNumberGenerator (const BasicRandomNumberGenerator& orig)            = default;
+  BasicRandomNumberGenerator& operator= (const BasicRandomNumberGenerator& orig) = default;
+  ~BasicRandomNumberGenerator ()                                                 = default;
 
   double realUniform (double lower, double upper);
   double realUniform_0_1 ();
   double realUniform_negPi_pi ();
 
-  double intUniform (int lower, int upper);
+  //
+  // Integers are drawn with Lemire's multiply-shift method, which
+  // needs one engine word and (almost always) no division or retry.
+  // uintBelow returns a value in [0, bound), bound > 0.
+  //
+  int           intUniform (int lower, int upper);
+  std::uint64_t uintBelow  (std::uint64_t bound);
 
   double realNormal (double mean, double stddev);
   double realNormal_0_1 ();
@@ -24,11 +135,251 @@ public:
   bool boolUniform ();
   bool boolWithTrueBias (double probOfTrue);
 
+  //
+  // Bulk generation.
+  //
+  // Each call fills out[0..count) with values drawn from the same
+  // distribution as the corresponding single-value call, but the
+  // generator is only touched in a tight loop and the conversion to
+  // doubles is vectorized (AVX2/SSE2 when available, scalar otherwise).
+  // The sequence produced differs from that of repeated single-value calls.
+  //
+
+  void realUniform          (double lower, double upper, double* out, std::size_t count);
+  void realUniform_0_1      (double* out, std::size_t count);
+  void realUniform_negPi_pi (double* out, std::size_t count);
+
+  void realNormal     (double mean, double stddev, double* out, std::size_t count);
+  void realNormal_0_1 (double* out, std::size_t count);
+
+  void intUniform (int lower, int upper, int* out, std::size_t count);
+
+  void                       jump  ();
+  BasicRandomNumberGenerator split ();
+
+  const EngineType& getEngine () const
+  { return _engine; }
+
 private:
-    std::mt19937                           _generator;
-    std::uniform_real_distribution<double> _uniformRealDist_0_1;
-    std::uniform_real_distribution<double> _uniformRealDist_negPi_pi;
-    std::normal_distribution<double>       _normalRealDist_0_1;
+  void   fillBits       (std::uint64_t* bits, std::size_t count);
+  double normalFromBits (std::uint64_t bits);
+
+  EngineType _engine;
 };
 
+typedef BasicRandomNumberGenerator<AnyEngine>          RandomNumberGenerator;
+typedef BasicRandomNumberGenerator<Xoshiro256PlusPlus> Xoshiro256RandomNumberGenerator;
+typedef BasicRandomNumberGenerator<Pcg64>              Pcg64RandomNumberGenerator;
+typedef BasicRandomNumberGenerator<Philox4x32>         PhiloxRandomNumberGenerator;
+
+template <typename EngineType>
+BasicRandomNumberGenerator<EngineType>::BasicRandomNumberGenerator ()
+  : _engine{(static_cast<std::uint64_t>(std::random_device{}()) << 32) | std::random_device{}()}
+{ }
+
+template <typename EngineType>
+BasicRandomNumberGenerator<EngineType>::BasicRandomNumberGenerator (std::random_device::result_type seed)
+  : _engine{seed}
+{ }
+
+template <typename EngineType>
+BasicRandomNumberGenerator<EngineType>::BasicRandomNumberGenerator (const EngineType& engine)
+  : _engine{engine}
+{ }
+
+template <typename EngineType>
+double BasicRandomNumberGenerator<EngineType>::realUniform (double lower, double upper)
+{ return lower + (upper - lower)*realUniform_0_1(); }
+
+template <typename EngineType>
+double BasicRandomNumberGenerator<EngineType>::realUniform_0_1 ()
+{ return RandomKernels::unitFromBits(_engine()); }
+
+template <typename EngineType>
+double BasicRandomNumberGenerator<EngineType>::realUniform_negPi_pi ()
+{ return realUniform(-boost::math::double_constants::pi, +boost::math::double_constants::pi); }
+
+template <typename EngineType>
+int BasicRandomNumberGenerator<EngineType>::intUniform (int lower, int upper)
+{
+  const std::uint64_t range = static_cast<std::uint64_t>(static_cast<std::int64_t>(upper) - lower) + 1;
+  return static_cast<int>(lower + static_cast<std::int64_t>(uintBelow(range)));
+}
+
+template <typename EngineType>
+std::uint64_t BasicRandomNumberGenerator<EngineType>::uintBelow (std::uint64_t bound)
+{
+  //
+  // The high word of word*bound is uniform on [0, bound) once the
+  // (bound - 2^64 mod bound) low words that would bias it are rejected.
+  // The modulo is only computed when the low word is small enough for
+  // a rejection to be possible at all.
+  //
+  unsigned __int128 product = static_cast<unsigned __int128>(_engine())*bound;
+  std::uint64_t     low     = static_cast<std::uint64_t>(product);
+  if (low < bound) {
+    const std::uint64_t threshold = (0 - bound) % bound;
+    while (low < threshold) {
+      product = static_cast<unsigned __int128>(_engine())*bound;
+      low     = static_cast<std::uint64_t>(product);
+    }
+  }
+  return static_cast<std::uint64_t>(product >> 64);
+}
+
+template <typename EngineType>
+double BasicRandomNumberGenerator<EngineType>::realNormal (double mean, double stddev)
+{ return mean + stddev*realNormal_0_1(); }
+
+template <typename EngineType>
+double BasicRandomNumberGenerator<EngineType>::realNormal_0_1 ()
+{ return normalFromBits(_engine()); }
+
+template <typename EngineType>
+double BasicRandomNumberGenerator<EngineType>::normalFromBits (std::uint64_t bits)
+{
+  using namespace RandomKernels;
+
+  for (;;) {
+    const unsigned int layer = bits & 0xFF;
+    const double       uu    = signedUnitFromBits(bits);
+
+    if (std::fabs(uu) < zigguratRatio[layer]) {
+      return uu*zigguratX[layer];
+    }
+
+    if (layer == 0) {
+      //
+      // Base strip: sample from the tail beyond kZigguratR.
+      //
+      double xx, yy;
+      do {
+        xx = std::log(1.0 - realUniform_0_1()) / kZigguratR;
+        yy = std::log(1.0 - realUniform_0_1());
+      } while (-2.0*yy < xx*xx);
+      return (uu < 0.0) ? (xx - kZigguratR) : (kZigguratR - xx);
+    }
+
+    //
+    // Wedge between the layer's rectangle and the curve.
+    //
+    const double xx = uu*zigguratX[layer];
+    const double f0 = std::exp(-0.5*(zigguratX[layer]*zigguratX[layer]     - xx*xx));
+    const double f1 = std::exp(-0.5*(zigguratX[layer+1]*zigguratX[layer+1] - xx*xx));
+    if (f1 + realUniform_0_1()*(f0 - f1) < 1.0) {
+      return xx;
+    }
+
+    bits = _engine();
+  }
+}
+
+template <typename EngineType>
+bool BasicRandomNumberGenerator<EngineType>::boolUniform ()
+{ return realUniform_0_1() <= 0.5; }
+
+template <typename EngineType>
+bool BasicRandomNumberGenerator<EngineType>::boolWithTrueBias (double probOfTrue)
+{ return realUniform_0_1() <= probOfTrue; }
+
+template <typename EngineType>
+void BasicRandomNumberGenerator<EngineType>::intUniform (int lower, int upper, int* out, std::size_t count)
+{
+  //
+  // Same method as uintBelow, but the rejection threshold
+  // is computed once for the whole batch.
+  //
+  const std::uint64_t range     = static_cast<std::uint64_t>(static_cast<std::int64_t>(upper) - lower) + 1;
+  const std::uint64_t threshold = (0 - range) % range;
+
+  std::uint64_t bits[RandomKernels::kBlockSize];
+  while (count > 0) {
+    std::size_t blockSize = std::min(count, RandomKernels::kBlockSize);
+    fillBits(bits, blockSize);
+    for (std::size_t idx = 0; idx < blockSize; ++idx) {
+      unsigned __int128 product = static_cast<unsigned __int128>(bits[idx])*range;
+      while (static_cast<std::uint64_t>(product) < threshold) {
+        product = static_cast<unsigned __int128>(_engine())*range;
+      }
+      out[idx] = static_cast<int>(lower + static_cast<std::int64_t>(product >> 64));
+    }
+    out   += blockSize;
+    count -= blockSize;
+  }
+}
+
+template <typename EngineType>
+void BasicRandomNumberGenerator<EngineType>::jump ()
+{
+  _engine.jump();
+}
+
+template <typename EngineType>
+BasicRandomNumberGenerator<EngineType> BasicRandomNumberGenerator<EngineType>::split ()
+{
+  BasicRandomNumberGenerator child{*this};
+  jump();
+  return child;
+}
+
+template <typename EngineType>
+void BasicRandomNumberGenerator<EngineType>::fillBits (std::uint64_t* bits, std::size_t count)
+{
+  if constexpr (std::is_same<EngineType, AnyEngine>::value) {
+    _engine.fill(bits, count);
+  }
+  else {
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      bits[idx] = _engine();
+    }
+  }
+}
+
+template <typename EngineType>
+void BasicRandomNumberGenerator<EngineType>::realUniform (double lower, double upper, double* out, std::size_t count)
+{
+  std::uint64_t bits[RandomKernels::kBlockSize];
+  while (count > 0) {
+    std::size_t blockSize = std::min(count, RandomKernels::kBlockSize);
+    fillBits(bits, blockSize);
+    RandomKernels::scaleBits(bits, lower, upper - lower, out, blockSize);
+    out   += blockSize;
+    count -= blockSize;
+  }
+}
+
+template <typename EngineType>
+void BasicRandomNumberGenerator<EngineType>::realUniform_0_1 (double* out, std::size_t count)
+{ realUniform(0.0, 1.0, out, count); }
+
+template <typename EngineType>
+void BasicRandomNumberGenerator<EngineType>::realUniform_negPi_pi (double* out, std::size_t count)
+{ realUniform(-boost::math::double_constants::pi, +boost::math::double_constants::pi, out, count); }
+
+template <typename EngineType>
+void BasicRandomNumberGenerator<EngineType>::realNormal (double mean, double stddev, double* out, std::size_t count)
+{
+  realNormal_0_1(out, count);
+  for (std::size_t idx = 0; idx < count; ++idx) {
+    out[idx] = mean + stddev*out[idx];
+  }
+}
+
+template <typename EngineType>
+void BasicRandomNumberGenerator<EngineType>::realNormal_0_1 (double* out, std::size_t count)
+{
+  std::uint64_t bits[RandomKernels::kBlockSize];
+  std::uint32_t slowIdx[RandomKernels::kBlockSize];
+  while (count > 0) {
+    std::size_t blockSize = std::min(count, RandomKernels::kBlockSize);
+    fillBits(bits, blockSize);
+    std::size_t numSlow = RandomKernels::zigguratFastPath(bits, out, blockSize, slowIdx);
+    for (std::size_t idx = 0; idx < numSlow; ++idx) {
+      out[slowIdx[idx]] = normalFromBits(bits[slowIdx[idx]]);
+    }
+    out   += blockSize;
+    count -= blockSize;
+  }
+}
+
 #endif // __RANDOM_NUMBER_GENERATOR_H__
@@ -1,8 +1,13 @@
 #ifndef __RANDOM_STATE_VALIDITY_CHECKER_H__
 #define __RANDOM_STATE_VALIDITY_CHECKER_H__
 
+#include "BatchValidity.h"
 #include "RandomNumberGenerator.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
 template <typename _SpaceType>
 class RandomStateValidityChecker
 {
@@ -19,6 +24,21 @@ public:
 
   bool isValid (const StateType& state) const;
 
+  //
+  // Replaces the stream the answers are drawn from.  Copies of a
+  // checker otherwise repeat each other's answers.
+  //
+  void setRandomNumberGenerator (const RandomNumberGenerator& rng);
+
+  //
+  // See BatchValidity.h.  The uniforms are drawn in bulk, so the
+  // results differ from those of repeated isValid calls.
+  //
+  std::size_t isValidMany (const StateType* states,
+                           std::size_t      numStates,
+                           std::uint64_t*   outValidMask,
+                           bool             stopAtFirstInvalid = false) const;
+
 private:
   double                        _probOfValid;
   mutable RandomNumberGenerator _rng;
@@ -37,8 +57,54 @@ RandomStateValidityChecker<SpaceType>::RandomStateValidityChecker (const  Random
   , _rng(rng)
 { }
 
+template <typename SpaceType>
+void RandomStateValidityChecker<SpaceType>::setRandomNumberGenerator (const RandomNumberGenerator& rng)
+{ _rng = rng; }
+
 template <typename SpaceType>
 bool RandomStateValidityChecker<SpaceType>::isValid (const typename SpaceType::StateType& state) const
 { return _rng.boolWithTrueBias(_probOfValid); }
 
-#endif // __RANDOM_STATE_VALIDITY_CHECKER_H__
\ No newline at end of file
+template <typename SpaceType>
+std::size_t RandomStateValidityChecker<SpaceType>::isValidMany (const StateType*,
+                                                                std::size_t      numStates,
+                                                                std::uint64_t*   outValidMask,
+                                                                bool             stopAtFirstInvalid) const
+{
+  if (outValidMask != nullptr) {
+    clearValidMask(outValidMask, numStates);
+  }
+
+  double uniforms[64];
+  std::size_t numValid = 0;
+  for (std::size_t begin = 0; begin < numStates; begin += 64) {
+    const std::size_t count = std::min<std::size_t>(64, numStates - begin);
+    _rng.realUniform_0_1(uniforms, count);
+
+    std::uint64_t word = 0;
+    for (std::size_t idx = 0; idx < count; ++idx) {
+      word |= std::uint64_t{uniforms[idx] <= _probOfValid} << idx;
+    }
+    if (stopAtFirstInvalid && ~word != 0) {
+      // Keep only the bits below the first invalid state.
+      const std::size_t firstInvalid = __builtin_ctzll(~word);
+      if (firstInvalid < count) {
+        word &= (std::uint64_t{1} << firstInvalid) - 1;
+        numValid += firstInvalid;
+        if (outValidMask != nullptr) {
+          outValidMask[begin/64] = word;
+        }
+        return numValid;
+      }
+    }
+
+    numValid += __builtin_popcountll(word);
+    if (outValidMask != nullptr) {
+      outValidMask[begin/64] = word;
+    }
+  }
+
+  return numValid;
+}
+
+#endif // __RANDOM_STATE_VALIDITY_CHECKER_H__
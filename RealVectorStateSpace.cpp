@@ -0,0 +1,240 @@
+#include "RealVectorStateSpace.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  //
+  // Per-call scratch for the sampling kernels is taken from the stack
+  // in blocks of this many coordinates, so that a space can be shared
+  // by several threads sampling from their own streams.
+  //
+  constexpr std::size_t kScratchSize = 64;
+}
+
+namespace RealVector
+{
+  //////////
+  // DynamicState
+  //////////
+
+  void draw (const DynamicState& state, std::ostream& ostr, std::size_t indent)
+  {
+    ostr << std::string(indent, ' ') << "RealVector::DynamicState (";
+    for (std::size_t idx = 0; idx < state.values.size(); ++idx) {
+      ostr << (idx ? ", " : "") << state.values[idx];
+    }
+    ostr << ")" << std::endl;
+  }
+
+  bool operator== (const DynamicState& lhs, const DynamicState& rhs)
+  { return lhs.values == rhs.values; }
+
+  bool operator!= (const DynamicState& lhs, const DynamicState& rhs)
+  { return !(lhs == rhs); }
+
+  bool operator< (const DynamicState& lhs, const DynamicState& rhs)
+  { return lhs.values < rhs.values; }
+
+  //////////
+  // DynamicSpace
+  //////////
+
+  DynamicSpace::DynamicSpace (unsigned int dimension, double low, double high)
+    : _low(dimension, low)
+    , _high(dimension, high)
+  { }
+
+  void DynamicSpace::setBounds (double low, double high)
+  {
+    std::fill(_low.begin(),  _low.end(),  low);
+    std::fill(_high.begin(), _high.end(), high);
+  }
+
+  void DynamicSpace::setBounds (std::size_t dim, double low, double high)
+  {
+    _low[dim]  = low;
+    _high[dim] = high;
+  }
+
+  double DynamicSpace::getLowBound (std::size_t dim) const
+  { return _low[dim]; }
+
+  double DynamicSpace::getHighBound (std::size_t dim) const
+  { return _high[dim]; }
+
+  DynamicState DynamicSpace::makeState () const
+  { return DynamicState{_low.size()}; }
+
+  DynamicState DynamicSpace::sampleUniform () const
+  {
+    DynamicState outState{makeState()};
+    sampleUniform(outState);
+    return outState;
+  }
+
+  void DynamicSpace::sampleUniform (DynamicState& outState) const
+  { sampleUniform(outState, _rng); }
+
+  void DynamicSpace::sampleUniform (DynamicState& outState, RandomNumberGenerator& rng) const
+  {
+    const std::size_t dimension = _low.size();
+    outState.values.resize(dimension);
+    rng.realUniform_0_1(outState.values.data(), dimension);
+    for (std::size_t idx = 0; idx < dimension; ++idx) {
+      outState.values[idx] = _low[idx] + (_high[idx] - _low[idx])*outState.values[idx];
+    }
+  }
+
+  DynamicState DynamicSpace::sampleUniformNear (const DynamicState& state, double radius) const
+  {
+    DynamicState outState{makeState()};
+    sampleUniformNear(state, radius, outState);
+    return outState;
+  }
+
+  void DynamicSpace::sampleUniformNear (const DynamicState& state, double radius, DynamicState& outState) const
+  { sampleUniformNear(state, radius, outState, _rng); }
+
+  void DynamicSpace::sampleUniformNear (const DynamicState& state, double radius, DynamicState& outState, RandomNumberGenerator& rng) const
+  {
+    const std::size_t dimension = _low.size();
+    outState.values.resize(dimension);
+
+    double unit[kScratchSize];
+    for (std::size_t begin = 0; begin < dimension; begin += kScratchSize) {
+      const std::size_t end = std::min(dimension, begin + kScratchSize);
+      rng.realUniform_0_1(unit, end - begin);
+      for (std::size_t idx = begin; idx < end; ++idx) {
+        const double low  = std::max(_low[idx],  state.values[idx] - radius);
+        const double high = std::min(_high[idx], state.values[idx] + radius);
+        outState.values[idx] = low + (high - low)*unit[idx - begin];
+      }
+    }
+  }
+
+  DynamicState DynamicSpace::sampleGaussianNear (const DynamicState& state, double stdDev) const
+  {
+    DynamicState outState{makeState()};
+    sampleGaussianNear(state, stdDev, outState);
+    return outState;
+  }
+
+  void DynamicSpace::sampleGaussianNear (const DynamicState& state, double stdDev, DynamicState& outState) const
+  { sampleGaussianNear(state, stdDev, outState, _rng); }
+
+  void DynamicSpace::sampleGaussianNear (const DynamicState& state, double stdDev, DynamicState& outState, RandomNumberGenerator& rng) const
+  {
+    const std::size_t dimension = _low.size();
+    outState.values.resize(dimension);
+
+    double offsets[kScratchSize];
+    for (std::size_t begin = 0; begin < dimension; begin += kScratchSize) {
+      const std::size_t end = std::min(dimension, begin + kScratchSize);
+      rng.realNormal(0.0, stdDev, offsets, end - begin);
+      for (std::size_t idx = begin; idx < end; ++idx) {
+        outState.values[idx] = std::min(_high[idx], std::max(_low[idx], state.values[idx] + offsets[idx - begin]));
+      }
+    }
+  }
+
+  void DynamicSpace::sampleFromUnitCube (const double* unitCoords, DynamicState& outState) const
+  {
+    const std::size_t dimension = _low.size();
+    outState.values.resize(dimension);
+    for (std::size_t idx = 0; idx < dimension; ++idx) {
+      outState.values[idx] = _low[idx] + (_high[idx] - _low[idx])*unitCoords[idx];
+    }
+  }
+
+  double DynamicSpace::distance (const DynamicState& fromState, const DynamicState& toState) const
+  {
+    const double* from = fromState.values.data();
+    const double* to   = toState.values.data();
+    double sumSq = 0.0;
+    for (std::size_t idx = 0; idx < _low.size(); ++idx) {
+      const double delta = from[idx] - to[idx];
+      sumSq += delta*delta;
+    }
+    return std::sqrt(sumSq);
+  }
+
+  void DynamicSpace::distanceMany (const DynamicState& fromState, const DynamicState* toStates, std::size_t numStates, double* outDistances) const
+  {
+    for (std::size_t stateIdx = 0; stateIdx < numStates; ++stateIdx) {
+      outDistances[stateIdx] = distance(fromState, toStates[stateIdx]);
+    }
+  }
+
+  DynamicState DynamicSpace::interpolate (const DynamicState& fromState, const DynamicState& toState, double tt) const
+  {
+    DynamicState newState{makeState()};
+    interpolate(fromState, toState, tt, newState);
+    return newState;
+  }
+
+  void DynamicSpace::interpolate (const DynamicState& fromState, const DynamicState& toState, double tt, DynamicState& outState) const
+  {
+    const std::size_t dimension = _low.size();
+    outState.values.resize(dimension);
+    for (std::size_t idx = 0; idx < dimension; ++idx) {
+      outState.values[idx] = fromState.values[idx] + tt*(toState.values[idx] - fromState.values[idx]);
+    }
+  }
+
+  bool DynamicSpace::satisfiesBounds (const DynamicState& state) const
+  {
+    int allInBounds = 1;
+    for (std::size_t idx = 0; idx < _low.size(); ++idx) {
+      allInBounds &= (state.values[idx] >= _low[idx]) & (state.values[idx] <= _high[idx]);
+    }
+    return allInBounds;
+  }
+
+  void DynamicSpace::enforceBounds (DynamicState& state) const
+  {
+    for (std::size_t idx = 0; idx < _low.size(); ++idx) {
+      state.values[idx] = std::min(_high[idx], std::max(_low[idx], state.values[idx]));
+    }
+  }
+
+  unsigned int DynamicSpace::getDimension () const
+  { return _low.size(); }
+
+  double DynamicSpace::getMaximumExtent () const
+  {
+    double sumSq = 0.0;
+    for (std::size_t idx = 0; idx < _low.size(); ++idx) {
+      sumSq += (_high[idx] - _low[idx])*(_high[idx] - _low[idx]);
+    }
+    return std::sqrt(sumSq);
+  }
+
+  double DynamicSpace::getMeasure () const
+  {
+    double measure = 1.0;
+    for (std::size_t idx = 0; idx < _low.size(); ++idx) {
+      measure *= _high[idx] - _low[idx];
+    }
+    return measure;
+  }
+
+  void DynamicSpace::appendSchema (std::string& schema) const
+  { schema += "RealVector<" + std::to_string(_low.size()) + ">"; }
+
+  std::size_t DynamicSpace::getSerializationSize () const
+  { return _low.size()*sizeof(double); }
+
+  void DynamicSpace::serialize (const DynamicState& state, unsigned char* outBytes) const
+  { std::memcpy(outBytes, state.values.data(), _low.size()*sizeof(double)); }
+
+  void DynamicSpace::deserialize (const unsigned char* bytes, DynamicState& outState) const
+  {
+    outState.values.resize(_low.size());
+    std::memcpy(outState.values.data(), bytes, _low.size()*sizeof(double));
+  }
+
+  void draw (const DynamicSpace& space, std::ostream& ostr, std::size_t indent)
+  { ostr << std::string(indent, ' ') << "RealVector::DynamicSpace<" << space.getDimension() << ">" << std::endl; }
+}
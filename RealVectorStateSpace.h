@@ -0,0 +1,379 @@
+#ifndef __REAL_VECTOR_STATE_SPACE_H__
+#define __REAL_VECTOR_STATE_SPACE_H__
+
+#include "AlignedAllocator.h"
+#include "RandomNumberGenerator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+//
+// Euclidean state spaces with per-dimension bounds.
+//
+// Space<N> fixes the dimension at compile time: states are aligned
+// std::arrays and every per-dimension loop has a constant trip count,
+// so the compiler unrolls and vectorizes distance, interpolate and the
+// sampling kernels for the exact N.  DynamicSpace is the runtime-N
+// counterpart, for dimensions only known once a problem is loaded.
+//
+
+namespace RealVector
+{
+  //////////
+  // State
+  //////////
+
+  template <std::size_t N>
+  class State
+  {
+  public:
+    typedef State StateType;
+
+    State ()
+    { values.fill(0.0); }
+    State (const std::array<double, N>& initialValues)
+    { std::copy(initialValues.begin(), initialValues.end(), values.begin()); }
+    State (const State& orig)            = default;
+    State& operator= (const State& orig) = default;
+    ~State ()                            = default;
+
+    double& operator[] (std::size_t idx)
+    { return values[idx]; }
+
+    double operator[] (std::size_t idx) const
+    { return values[idx]; }
+
+    friend void draw (const State& state, std::ostream& ostr, std::size_t indent)
+    {
+      ostr << std::string(indent, ' ') << "RealVector::State (";
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        ostr << (idx ? ", " : "") << state.values[idx];
+      }
+      ostr << ")" << std::endl;
+    }
+
+    alignas(32) std::array<double, N> values;
+  };
+
+  template <std::size_t N>
+  bool operator== (const State<N>& lhs, const State<N>& rhs)
+  { return lhs.values == rhs.values; }
+
+  template <std::size_t N>
+  bool operator!= (const State<N>& lhs, const State<N>& rhs)
+  { return !(lhs == rhs); }
+
+  template <std::size_t N>
+  bool operator< (const State<N>& lhs, const State<N>& rhs)
+  { return lhs.values < rhs.values; }
+
+  //////////
+  // Space
+  //////////
+
+  template <std::size_t N>
+  class Space
+  {
+  public:
+    typedef State<N> StateType;
+
+    //
+    // The default bounds are the unit cube.
+    //
+    Space ()
+    { setBounds(0.0, 1.0); }
+    Space (double low, double high)
+    { setBounds(low, high); }
+    Space (const std::array<double, N>& low, const std::array<double, N>& high)
+    {
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        setBounds(idx, low[idx], high[idx]);
+      }
+    }
+    Space (const Space& orig)           = default;
+    Space& operator=(const Space& orig) = default;
+    ~Space ()                           = default;
+
+    void setBounds (double low, double high)
+    {
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        setBounds(idx, low, high);
+      }
+    }
+
+    void setBounds (std::size_t dim, double low, double high)
+    {
+      _low[dim]  = low;
+      _high[dim] = high;
+    }
+
+    double getLowBound (std::size_t dim) const
+    { return _low[dim]; }
+
+    double getHighBound (std::size_t dim) const
+    { return _high[dim]; }
+
+    State<N> makeState () const
+    { return State<N>{}; }
+
+    State<N> sampleUniform () const
+    {
+      State<N> outState;
+      sampleUniform(outState);
+      return outState;
+    }
+
+    void sampleUniform (State<N>& outState) const
+    { sampleUniform(outState, _rng); }
+
+    void sampleUniform (State<N>& outState, RandomNumberGenerator& rng) const
+    {
+      rng.realUniform_0_1(outState.values.data(), N);
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        outState.values[idx] = _low[idx] + (_high[idx] - _low[idx])*outState.values[idx];
+      }
+    }
+
+    State<N> sampleUniformNear (const State<N>& state, double radius) const
+    {
+      State<N> outState;
+      sampleUniformNear(state, radius, outState);
+      return outState;
+    }
+
+    void sampleUniformNear (const State<N>& state, double radius, State<N>& outState) const
+    { sampleUniformNear(state, radius, outState, _rng); }
+
+    //
+    // Each coordinate is uniform on [x - radius, x + radius]
+    // intersected with the bounds.
+    //
+    void sampleUniformNear (const State<N>& state, double radius, State<N>& outState, RandomNumberGenerator& rng) const
+    {
+      alignas(32) std::array<double, N> unit;
+      rng.realUniform_0_1(unit.data(), N);
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        const double low  = std::max(_low[idx],  state.values[idx] - radius);
+        const double high = std::min(_high[idx], state.values[idx] + radius);
+        outState.values[idx] = low + (high - low)*unit[idx];
+      }
+    }
+
+    State<N> sampleGaussianNear (const State<N>& state, double stdDev) const
+    {
+      State<N> outState;
+      sampleGaussianNear(state, stdDev, outState);
+      return outState;
+    }
+
+    void sampleGaussianNear (const State<N>& state, double stdDev, State<N>& outState) const
+    { sampleGaussianNear(state, stdDev, outState, _rng); }
+
+    void sampleGaussianNear (const State<N>& state, double stdDev, State<N>& outState, RandomNumberGenerator& rng) const
+    {
+      alignas(32) std::array<double, N> offsets;
+      rng.realNormal(0.0, stdDev, offsets.data(), N);
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        outState.values[idx] = std::min(_high[idx], std::max(_low[idx], state.values[idx] + offsets[idx]));
+      }
+    }
+
+    void sampleFromUnitCube (const double* unitCoords, State<N>& outState) const
+    {
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        outState.values[idx] = _low[idx] + (_high[idx] - _low[idx])*unitCoords[idx];
+      }
+    }
+
+    double distance (const State<N>& fromState, const State<N>& toState) const
+    {
+      double sumSq = 0.0;
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        const double delta = fromState.values[idx] - toState.values[idx];
+        sumSq += delta*delta;
+      }
+      return std::sqrt(sumSq);
+    }
+
+    void distanceMany (const State<N>& fromState, const State<N>* toStates, std::size_t numStates, double* outDistances) const
+    {
+      for (std::size_t stateIdx = 0; stateIdx < numStates; ++stateIdx) {
+        outDistances[stateIdx] = distance(fromState, toStates[stateIdx]);
+      }
+    }
+
+    State<N> interpolate (const State<N>& fromState, const State<N>& toState, double tt) const
+    {
+      State<N> newState;
+      interpolate(fromState, toState, tt, newState);
+      return newState;
+    }
+
+    void interpolate (const State<N>& fromState, const State<N>& toState, double tt, State<N>& outState) const
+    {
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        outState.values[idx] = fromState.values[idx] + tt*(toState.values[idx] - fromState.values[idx]);
+      }
+    }
+
+    bool satisfiesBounds (const State<N>& state) const
+    {
+      int allInBounds = 1;
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        allInBounds &= (state.values[idx] >= _low[idx]) & (state.values[idx] <= _high[idx]);
+      }
+      return allInBounds;
+    }
+
+    void enforceBounds (State<N>& state) const
+    {
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        state.values[idx] = std::min(_high[idx], std::max(_low[idx], state.values[idx]));
+      }
+    }
+
+    unsigned int getDimension () const
+    { return N; }
+
+    double getMaximumExtent () const
+    {
+      double sumSq = 0.0;
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        sumSq += (_high[idx] - _low[idx])*(_high[idx] - _low[idx]);
+      }
+      return std::sqrt(sumSq);
+    }
+
+    double getMeasure () const
+    {
+      double measure = 1.0;
+      for (std::size_t idx = 0; idx < N; ++idx) {
+        measure *= _high[idx] - _low[idx];
+      }
+      return measure;
+    }
+
+    //
+    // Binary serialization: the N values as doubles in host byte
+    // order.  Space<N> and a DynamicSpace of dimension N share a
+    // schema, so either can read what the other wrote.
+    //
+    void appendSchema (std::string& schema) const
+    { schema += "RealVector<" + std::to_string(N) + ">"; }
+
+    std::size_t getSerializationSize () const
+    { return N*sizeof(double); }
+
+    void serialize (const State<N>& state, unsigned char* outBytes) const
+    { std::memcpy(outBytes, state.values.data(), N*sizeof(double)); }
+
+    void deserialize (const unsigned char* bytes, State<N>& outState) const
+    { std::memcpy(outState.values.data(), bytes, N*sizeof(double)); }
+
+    friend void draw (const Space&, std::ostream& ostr, std::size_t indent)
+    { ostr << std::string(indent, ' ') << "RealVector::Space<" << N << ">" << std::endl; }
+
+  private:
+    alignas(32) std::array<double, N> _low;
+    alignas(32) std::array<double, N> _high;
+    mutable RandomNumberGenerator     _rng;
+  };
+
+  //////////
+  // Runtime dimension
+  //////////
+
+  class DynamicState
+  {
+  public:
+    typedef DynamicState StateType;
+
+    explicit DynamicState (std::size_t dimension=0)
+      : values(dimension, 0.0)
+    { }
+    DynamicState (const DynamicState& orig)            = default;
+    DynamicState& operator= (const DynamicState& orig) = default;
+    ~DynamicState ()                                   = default;
+
+    double& operator[] (std::size_t idx)
+    { return values[idx]; }
+
+    double operator[] (std::size_t idx) const
+    { return values[idx]; }
+
+    friend void draw (const DynamicState& state, std::ostream& ostr, std::size_t indent);
+
+    AlignedVector<double> values;
+  };
+
+  bool operator== (const DynamicState& lhs, const DynamicState& rhs);
+  bool operator!= (const DynamicState& lhs, const DynamicState& rhs);
+  bool operator<  (const DynamicState& lhs, const DynamicState& rhs);
+
+  class DynamicSpace
+  {
+  public:
+    typedef DynamicState StateType;
+
+    explicit DynamicSpace (unsigned int dimension, double low=0.0, double high=1.0);
+    DynamicSpace (const DynamicSpace& orig)           = default;
+    DynamicSpace& operator=(const DynamicSpace& orig) = default;
+    ~DynamicSpace ()                                  = default;
+
+    void setBounds (double low, double high);
+    void setBounds (std::size_t dim, double low, double high);
+
+    double getLowBound  (std::size_t dim) const;
+    double getHighBound (std::size_t dim) const;
+
+    DynamicState makeState () const;
+
+    DynamicState sampleUniform () const;
+    void         sampleUniform (DynamicState& outState) const;
+    void         sampleUniform (DynamicState& outState, RandomNumberGenerator& rng) const;
+
+    DynamicState sampleUniformNear (const DynamicState& state, double radius) const;
+    void         sampleUniformNear (const DynamicState& state, double radius, DynamicState& outState) const;
+    void         sampleUniformNear (const DynamicState& state, double radius, DynamicState& outState, RandomNumberGenerator& rng) const;
+
+    DynamicState sampleGaussianNear (const DynamicState& state, double stdDev) const;
+    void         sampleGaussianNear (const DynamicState& state, double stdDev, DynamicState& outState) const;
+    void         sampleGaussianNear (const DynamicState& state, double stdDev, DynamicState& outState, RandomNumberGenerator& rng) const;
+
+    void sampleFromUnitCube (const double* unitCoords, DynamicState& outState) const;
+
+    double distance     (const DynamicState& fromState, const DynamicState& toState) const;
+    void   distanceMany (const DynamicState& fromState, const DynamicState* toStates, std::size_t numStates, double* outDistances) const;
+
+    DynamicState interpolate (const DynamicState& fromState, const DynamicState& toState, double tt) const;
+    void         interpolate (const DynamicState& fromState, const DynamicState& toState, double tt, DynamicState& outState) const;
+
+    bool satisfiesBounds (const DynamicState& state) const;
+    void enforceBounds   (DynamicState& state) const;
+
+    unsigned int getDimension () const;
+
+    double getMaximumExtent () const;
+
+    double getMeasure () const;
+
+    void        appendSchema (std::string& schema) const;
+    std::size_t getSerializationSize () const;
+    void        serialize   (const DynamicState& state, unsigned char* outBytes) const;
+    void        deserialize (const unsigned char* bytes, DynamicState& outState) const;
+
+    friend void draw (const DynamicSpace& space, std::ostream& ostr, std::size_t indent);
+
+  private:
+    AlignedVector<double>         _low;
+    AlignedVector<double>         _high;
+    mutable RandomNumberGenerator _rng;
+  };
+}
+
+#endif // __REAL_VECTOR_STATE_SPACE_H__
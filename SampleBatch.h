@@ -0,0 +1,111 @@
+#ifndef __SAMPLE_BATCH_H__
+#define __SAMPLE_BATCH_H__
+
+#include "OmplConcepts.h"
+#include "RandomNumberGenerator.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace Samplers
+{
+  //
+  // Scratch states for samplers that draw their candidates in batches.
+  //
+  // The states are made once, with the space's layout, and refilled by
+  // every batch, so rejected candidates cost no allocations.  Batches
+  // use the space's pointer-array kernels (see OmplBatchSamplingSpace)
+  // when it has them.
+  //
+  // A sampler's scratch belongs to that sampler object: copies and
+  // assignments leave the destination empty, to be allocated again
+  // on first use.
+  //
+  template<typename SpaceType>
+  class SampleBatch
+  {
+  public:
+    typedef typename SpaceType::StateType StateType;
+
+    SampleBatch () = default;
+
+    SampleBatch (const SampleBatch&)
+    { }
+
+    SampleBatch (SampleBatch&& sink) = default;
+
+    SampleBatch& operator= (const SampleBatch&)
+    {
+      _states.clear();
+      _pointers.clear();
+      return *this;
+    }
+
+    SampleBatch& operator= (SampleBatch&& sink) = default;
+    ~SampleBatch ()                             = default;
+
+    //
+    // Makes sure there are (at least) size states from space.
+    //
+    void allocate (const SpaceType& space, std::size_t size)
+    {
+      if (_states.size() >= size) {
+        return;
+      }
+      _states.assign(size, space.makeState());
+      _pointers.clear();
+      for (auto& state : _states) {
+        _pointers.push_back(&state);
+      }
+    }
+
+    std::size_t size () const
+    { return _states.size(); }
+
+    StateType& operator[] (std::size_t idx)
+    { return _states[idx]; }
+
+    const StateType& operator[] (std::size_t idx) const
+    { return _states[idx]; }
+
+    const StateType* data () const
+    { return _states.data(); }
+
+    // Fill the first numStates states with uniform samples.
+    void sampleUniform (const SpaceType& space, std::size_t numStates, RandomNumberGenerator& rng)
+    {
+      if constexpr (OmplBatchSamplingSpace<SpaceType>()) {
+        space.sampleUniformMany(_pointers.data(), numStates, rng);
+      }
+      else {
+        for (std::size_t idx = 0; idx < numStates; ++idx) {
+          space.sampleUniform(_states[idx], rng);
+        }
+      }
+    }
+
+    //
+    // Fill the first numStates states with Gaussian samples around
+    // the corresponding states of centers.
+    //
+    void sampleGaussianNear (const SpaceType& space, const SampleBatch& centers, double stddev,
+                             std::size_t numStates, RandomNumberGenerator& rng)
+    {
+      if constexpr (OmplBatchSamplingSpace<SpaceType>()) {
+        const StateType* const* centerPointers = centers._pointers.data();
+        space.sampleGaussianNearMany(centerPointers, stddev, _pointers.data(), numStates, rng);
+      }
+      else {
+        for (std::size_t idx = 0; idx < numStates; ++idx) {
+          space.sampleGaussianNear(centers._states[idx], stddev, _states[idx], rng);
+        }
+      }
+    }
+
+  private:
+    std::vector<StateType>  _states;
+    std::vector<StateType*> _pointers;
+  };
+}
+
+#endif // __SAMPLE_BATCH_H__
@@ -0,0 +1,284 @@
+#ifndef __SAMPLE_PRODUCER_POOL_H__
+#define __SAMPLE_PRODUCER_POOL_H__
+
+#include "BoundedRingBuffer.h"
+#include "OmplConcepts.h"
+#include "RandomNumberGenerator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace Samplers
+{
+  //
+  // Background sampling: worker threads draw valid samples and queue
+  // them for planners to pop, so that validity checking runs on
+  // otherwise idle cores.
+  //
+  // SamplerType is a sampler with getSpace() and sample(state, rng):
+  //
+  // - UniformSampler or GaussianSampler, whose samples the pool checks
+  //   with the ValidatorType it is given, or
+  // - a validating sampler (ValidatingGaussianSampler,
+  //   BridgeTestSampler, ObstacleBasedSampler; see
+  //   OmplValidatingSampler), which is given to the pool on its own:
+  //   its samples have already been accepted by its validator and are
+  //   queued as they are.
+  //
+  // (QuasiRandomSampler does not fit: a Halton sequence does not split
+  // into per-worker streams.)
+  //
+  // Every worker has its own copy of the sampler and validator (they
+  // share the space through its handle) and its own stream, split from
+  // the pool's generator in worker order.  Validators that draw from a
+  // stream of their own (see OmplRandomizedValidityChecker), including
+  // a validating sampler's, get one split from the worker's.  Which worker produces which
+  // popped state depends on scheduling, so the order of popped states
+  // is not reproducible even though each worker's stream is.
+  //
+  // Workers stop producing while the queue is full.  A validating
+  // sampler that would keep trying until it finds a sample (the
+  // default) is given kMaxAttemptsPerSample, so that its worker sees
+  // stop() even where no sample can be found.  If a sampler or
+  // validator throws, the pool stops and pop rethrows the exception
+  // once the queue is empty.
+  //
+  template<typename SamplerType,
+           typename ValidatorType = std::decay_t<decltype(std::declval<const SamplerType&>().getValidator())>>
+  class SampleProducerPool
+  {
+  public:
+    typedef typename ValidatorType::StateType StateType;
+
+    static constexpr std::size_t kMaxAttemptsPerSample = 1000;
+
+    SampleProducerPool (const SamplerType&    sampler,
+                        const ValidatorType&  validator,
+                        unsigned int          numWorkers,
+                        std::size_t           capacity,
+                        RandomNumberGenerator rng = RandomNumberGenerator{})
+      : _buffer(capacity)
+      , _numWorkers(checkNumWorkers(numWorkers))
+      , _workers(new Worker[numWorkers])
+    {
+      static_assert(!OmplValidatingSampler<SamplerType>(), "a validating sampler is given to the pool without a validator");
+      start(sampler, validator, rng);
+    }
+
+    SampleProducerPool (const SamplerType&    sampler,
+                        unsigned int          numWorkers,
+                        std::size_t           capacity,
+                        RandomNumberGenerator rng = RandomNumberGenerator{})
+      : _buffer(capacity)
+      , _numWorkers(checkNumWorkers(numWorkers))
+      , _workers(new Worker[numWorkers])
+    {
+      static_assert(OmplValidatingSampler<SamplerType>(), "a sampler that does not validate needs a validator");
+      start(sampler, std::nullopt, rng);
+    }
+
+    SampleProducerPool (const SampleProducerPool& orig)            = delete;
+    SampleProducerPool& operator= (const SampleProducerPool& orig) = delete;
+
+    ~SampleProducerPool ()
+    { stop(); }
+
+    //
+    // Stops and joins the workers.  States already queued can still
+    // be popped.
+    //
+    void stop ()
+    {
+      _stopping.store(true, std::memory_order_relaxed);
+      for (unsigned int idx = 0; idx < _numWorkers; ++idx) {
+        if (_workers[idx].thread.joinable()) {
+          _workers[idx].thread.join();
+        }
+      }
+    }
+
+    //
+    // Pops a valid state into outState if one is queued.
+    //
+    bool tryPop (StateType& outState)
+    {
+      if (_buffer.tryPop(outState)) {
+        return true;
+      }
+      rethrowWorkerError();
+      return false;
+    }
+
+    //
+    // Waits for a valid state.  Returns false only if the pool has
+    // been stopped and its queue is empty.
+    //
+    bool pop (StateType& outState)
+    {
+      for (unsigned int spins = 0; ; ++spins) {
+        if (tryPop(outState)) {
+          return true;
+        }
+        if (_stopping.load(std::memory_order_relaxed)) {
+          return tryPop(outState);
+        }
+        backOff(spins);
+      }
+    }
+
+    unsigned int getNumWorkers () const
+    { return _numWorkers; }
+
+    std::size_t getCapacity () const
+    { return _buffer.capacity(); }
+
+    //
+    // Totals over all workers so far: samples that passed (and were
+    // queued or are about to be), and samples that were rejected or
+    // sample() calls that gave up.
+    //
+    std::size_t getNumAccepted () const
+    { return sumCounters(&Worker::numAccepted); }
+
+    std::size_t getNumRejected () const
+    { return sumCounters(&Worker::numRejected); }
+
+  private:
+    //
+    // Each worker's counters are on their own cache line so that
+    // counting does not make the workers contend.
+    //
+    struct alignas(64) Worker
+    {
+      std::thread              thread;
+      std::atomic<std::size_t> numAccepted{0};
+      std::atomic<std::size_t> numRejected{0};
+    };
+
+    static unsigned int checkNumWorkers (unsigned int numWorkers)
+    {
+      if (numWorkers == 0) {
+        throw std::invalid_argument{"SampleProducerPool: numWorkers must be at least 1"};
+      }
+      return numWorkers;
+    }
+
+    void start (const SamplerType& sampler, const std::optional<ValidatorType>& validator, RandomNumberGenerator& rng)
+    {
+      try {
+        for (unsigned int idx = 0; idx < _numWorkers; ++idx) {
+          _workers[idx].thread = std::thread(&SampleProducerPool::produce, this, std::ref(_workers[idx]),
+                                             sampler, validator, rng.split());
+        }
+      }
+      catch (...) {
+        stop();
+        throw;
+      }
+    }
+
+    //
+    // validator is empty for validating samplers.
+    //
+    void produce (Worker& worker, SamplerType sampler, std::optional<ValidatorType> validator, RandomNumberGenerator rng)
+    {
+      try {
+        if constexpr (OmplValidatingSampler<SamplerType>()) {
+          if (sampler.getMaxAttempts() == 0) {
+            sampler.setMaxAttempts(kMaxAttemptsPerSample);
+          }
+          if constexpr (OmplRandomizedValidityChecker<ValidatorType>()) {
+            ValidatorType samplerValidator{sampler.getValidator()};
+            samplerValidator.setRandomNumberGenerator(rng.split());
+            sampler.setValidator(samplerValidator);
+          }
+        }
+        else if constexpr (OmplRandomizedValidityChecker<ValidatorType>()) {
+          validator->setRandomNumberGenerator(rng.split());
+        }
+
+        const StateType protoState = sampler.getSpace()->makeState();
+        StateType state{protoState};
+        while (!_stopping.load(std::memory_order_relaxed)) {
+          if (!sampler.sample(state, rng) || (validator && !validator->isValid(state))) {
+            worker.numRejected.store(worker.numRejected.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            continue;
+          }
+          worker.numAccepted.store(worker.numAccepted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+          for (unsigned int spins = 0; !_buffer.tryPush(std::move(state)); ++spins) {
+            if (_stopping.load(std::memory_order_relaxed)) {
+              return;
+            }
+            backOff(spins);
+          }
+
+          // The push left state with whatever the queue cell held
+          // (often a previously popped state's buffer); give it the
+          // space's layout again.  Assigning between states of one
+          // layout does not allocate.
+          state = protoState;
+        }
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(_errorMutex);
+        if (!_workerError) {
+          _workerError = std::current_exception();
+        }
+        _stopping.store(true, std::memory_order_relaxed);
+      }
+    }
+
+    void rethrowWorkerError ()
+    {
+      if (!_stopping.load(std::memory_order_relaxed)) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(_errorMutex);
+      if (_workerError) {
+        std::rethrow_exception(std::exchange(_workerError, nullptr));
+      }
+    }
+
+    std::size_t sumCounters (std::atomic<std::size_t> Worker::* counter) const
+    {
+      std::size_t total = 0;
+      for (unsigned int idx = 0; idx < _numWorkers; ++idx) {
+        total += (_workers[idx].*counter).load(std::memory_order_relaxed);
+      }
+      return total;
+    }
+
+    //
+    // Yield for a while, then sleep, so that an idle pool or
+    // planner does not keep a core busy.
+    //
+    static void backOff (unsigned int spins)
+    {
+      if (spins < 64) {
+        std::this_thread::yield();
+      }
+      else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+
+    BoundedRingBuffer<StateType> _buffer;
+    std::atomic<bool>            _stopping{false};
+    std::mutex                   _errorMutex;
+    std::exception_ptr           _workerError;
+    const unsigned int           _numWorkers;
+    std::unique_ptr<Worker[]>    _workers;
+  };
+}
+
+#endif // __SAMPLE_PRODUCER_POOL_H__
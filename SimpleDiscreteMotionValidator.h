@@ -3,10 +3,14 @@
 
 #include <iostream>
 using namespace std;
+#include <algorithm>
 #include <cmath>
 #include <queue>
 #include <utility>
 
+#include "BatchValidity.h"
+#include "SampleBatch.h"
+#include "SpaceHandle.h"
 
 template <typename ValidatorType>
 class SimpleDiscreteMotionValidator
@@ -15,9 +19,11 @@ public:
   typedef typename ValidatorType::SpaceType SpaceType;
   typedef typename ValidatorType::StateType StateType;
 
-  SimpleDiscreteMotionValidator ()                                                     = default;
+  SimpleDiscreteMotionValidator ();
   SimpleDiscreteMotionValidator (const ValidatorType& validator,
                                  const SpaceType&     space);
+  SimpleDiscreteMotionValidator (const ValidatorType&   validator,
+                                 SpaceHandle<SpaceType> spSpace);
   SimpleDiscreteMotionValidator (const SimpleDiscreteMotionValidator& orig)            = default;
   SimpleDiscreteMotionValidator& operator= (const SimpleDiscreteMotionValidator& orig) = default;
   ~SimpleDiscreteMotionValidator ()                                                    = default;
@@ -32,15 +38,30 @@ public:
   bool checkMotion (const StateType& fromState, const StateType& toState) const;
 
 private:
-  ValidatorType _validator;
-  SpaceType     _space;
+  // The most intermediate states checked in one isValidMany call.
+  static constexpr std::size_t kBatchSize = 64;
+
+  ValidatorType          _validator;
+  SpaceHandle<SpaceType> _spSpace;
 };
 
+template <typename ValidatorType>
+SimpleDiscreteMotionValidator<ValidatorType>::SimpleDiscreteMotionValidator ()
+  : _spSpace{makeSpaceHandle(SpaceType{})}
+{ }
+
 template <typename ValidatorType>
 SimpleDiscreteMotionValidator<ValidatorType>::SimpleDiscreteMotionValidator (const ValidatorType& validator,
                                                                              const SpaceType&     space)
   : _validator{validator}
-  , _space{space}
+  , _spSpace{makeSpaceHandle(space)}
+{ }
+
+template <typename ValidatorType>
+SimpleDiscreteMotionValidator<ValidatorType>::SimpleDiscreteMotionValidator (const ValidatorType&   validator,
+                                                                             SpaceHandle<SpaceType> spSpace)
+  : _validator{validator}
+  , _spSpace{std::move(spSpace)}
 { }
 
 template <typename ValidatorType>
@@ -74,7 +95,7 @@ bool SimpleDiscreteMotionValidator<ValidatorType>::checkMotion (const StateType&
   // and longestValidSegmentCountFactor, so I'm ignoring the latter.
   //
 
-  int numSegs = std::ceil(_space.distance(fromState, toState) / maxSegLen);
+  int numSegs = std::ceil(_spSpace->distance(fromState, toState) / maxSegLen);
 
   //
   // If there is only one segment, the only states that needed
@@ -100,38 +121,46 @@ bool SimpleDiscreteMotionValidator<ValidatorType>::checkMotion (const StateType&
   //    - add it to the interval queue
   // - stop; the motion is valid
   //
+  // The midpoints are checked kBatchSize at a time, in the order
+  // above, stopping at the first invalid one.  Batch-capable checkers
+  // (see OmplBatchValidityChecker) get each batch in one call.
+  //
+  // The batch is local rather than a member so that checkMotion can be
+  // called on one validator from several threads; it is sized to the
+  // motion, so short motions make only a few states.
+  //
 
   std::queue<std::pair<int, int>> intervals;
   intervals.push(std::make_pair(1, numSegs-1));
 
-  StateType midState;
+  Samplers::SampleBatch<SpaceType> midStates;
+  midStates.allocate(*_spSpace, std::min<std::size_t>(numSegs-1, kBatchSize));
 
-  bool motionIsValid = true;
   while (!intervals.empty())
   {
-    // Avoid making a copy.
-    auto& curInterval = intervals.front();
+    std::size_t numStates = 0;
+    while (!intervals.empty() && numStates < midStates.size()) {
+      const auto curInterval = intervals.front();
+      intervals.pop();
 
-    int midIdx = (curInterval.first + curInterval.second) / 2;
+      int midIdx = (curInterval.first + curInterval.second) / 2;
 
-    _space.interpolate(fromState, toState, ((double)midIdx) / numSegs, midState);
+      _spSpace->interpolate(fromState, toState, ((double)midIdx) / numSegs, midStates[numStates++]);
 
-    if (!_validator.isValid(midState)) {
-      motionIsValid = false;
-      break;
+      if (curInterval.first < midIdx) {
+        intervals.push(std::make_pair(curInterval.first, midIdx - 1));
+      }
+      if (curInterval.second > midIdx) {
+        intervals.push(std::make_pair(midIdx + 1, curInterval.second));
+      }
     }
 
-    intervals.pop();
-
-    if (curInterval.first < midIdx) {
-      intervals.push(std::make_pair(curInterval.first, midIdx - 1));
-    }
-    if (curInterval.second > midIdx) {
-      intervals.push(std::make_pair(midIdx + 1, curInterval.second));
+    if (isValidMany(_validator, midStates.data(), numStates, nullptr, true) < numStates) {
+      return false;
     }
   }
 
-  return motionIsValid;
+  return true;
 }
 
 
@@ -0,0 +1,203 @@
+#ifndef __SO2_FIXED_POINT_STATE_SPACE_H__
+#define __SO2_FIXED_POINT_STATE_SPACE_H__
+
+#include "RandomNumberGenerator.h"
+
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+//
+// Compact SO2 variant that stores an angle as an unsigned fixed-point
+// fraction of a full turn: a WordType of B bits represents the angle
+// turns * 2pi / 2^B, read as a signed value so that it lies in [-pi, pi).
+//
+// Every WordType value is a valid angle and wrap-around is plain
+// unsigned overflow, so enforceBounds is a no-op, interpolate needs no
+// branches and distance is a subtract plus a min.  The resolution is
+// 2pi / 2^B (about 1e-4 rad for 16 bits, 1.5e-9 rad for 32 bits).
+//
+
+namespace SO2
+{
+  template <typename WordType>
+  class FixedPointState
+  {
+    static_assert(std::is_unsigned<WordType>::value && sizeof(WordType) <= 4,
+                  "FixedPointState requires an unsigned word of at most 32 bits");
+
+  public:
+    typedef FixedPointState StateType;
+    typedef typename std::make_signed<WordType>::type SignedWordType;
+
+    static constexpr int    kNumBits        = 8*sizeof(WordType);
+    static constexpr double kRadiansPerUnit = boost::math::double_constants::two_pi / (std::uint64_t{1} << kNumBits);
+    static constexpr double kUnitsPerRadian = 1.0 / kRadiansPerUnit;
+
+    FixedPointState (WordType angle_turns=0)
+      : turns{angle_turns}
+    { }
+    FixedPointState (const FixedPointState& orig)            = default;
+    FixedPointState& operator= (const FixedPointState& orig) = default;
+    ~FixedPointState ()                                      = default;
+
+    static FixedPointState fromRadians (double angle_rad)
+    { return FixedPointState{unitsFromRadians(angle_rad)}; }
+
+    double toRadians () const
+    { return static_cast<SignedWordType>(turns)*kRadiansPerUnit; }
+
+    //
+    // Convert a (possibly large, possibly negative) angle to units,
+    // modulo a full turn.
+    //
+    static WordType unitsFromRadians (double angle_rad)
+    { return static_cast<WordType>(std::llround(std::remainder(angle_rad, boost::math::double_constants::two_pi)*kUnitsPerRadian)); }
+
+    friend void draw (const FixedPointState& state, std::ostream& ostr, std::size_t indent)
+    { ostr << std::string(indent, ' ') << "SO2::FixedPointState (" << state.toRadians() << ")" << std::endl; }
+
+    WordType turns;
+  };
+
+  template <typename WordType>
+  bool operator== (const FixedPointState<WordType>& lhs, const FixedPointState<WordType>& rhs)
+  { return lhs.turns == rhs.turns; }
+
+  template <typename WordType>
+  bool operator!= (const FixedPointState<WordType>& lhs, const FixedPointState<WordType>& rhs)
+  { return !(lhs == rhs); }
+
+  template <typename WordType>
+  bool operator< (const FixedPointState<WordType>& lhs, const FixedPointState<WordType>& rhs)
+  { return lhs.toRadians() < rhs.toRadians(); }
+
+  template <typename WordType>
+  class FixedPointSpace
+  {
+  public:
+    typedef FixedPointState<WordType>     State;
+    typedef State                         StateType;
+    typedef typename State::SignedWordType SignedWordType;
+
+    FixedPointSpace ()                                      = default;
+    explicit FixedPointSpace (const RandomNumberGenerator& rng)
+      : _rng{rng}
+    { }
+    FixedPointSpace (const FixedPointSpace& orig)           = default;
+    FixedPointSpace& operator=(const FixedPointSpace& orig) = default;
+    ~FixedPointSpace ()                                     = default;
+
+    State makeState () const
+    { return State{}; }
+
+    State sampleUniform () const
+    {
+      State outState;
+      sampleUniform(outState);
+      return outState;
+    }
+
+    void sampleUniform (State& outState) const
+    { sampleUniform(outState, _rng); }
+
+    void sampleUniform (State& outState, RandomNumberGenerator& rng) const
+    { outState.turns = static_cast<WordType>(rng.uintBelow(std::uint64_t{1} << State::kNumBits)); }
+
+    State sampleUniformNear (const State& state, double radius) const
+    {
+      State outState;
+      sampleUniformNear(state, radius, outState);
+      return outState;
+    }
+
+    void sampleUniformNear (const State& state, double radius, State& outState) const
+    { sampleUniformNear(state, radius, outState, _rng); }
+
+    void sampleUniformNear (const State& state, double radius, State& outState, RandomNumberGenerator& rng) const
+    { outState.turns = static_cast<WordType>(state.turns + State::unitsFromRadians(rng.realUniform(-radius, radius))); }
+
+    State sampleGaussianNear (const State& state, double stdDev) const
+    {
+      State outState;
+      sampleGaussianNear(state, stdDev, outState);
+      return outState;
+    }
+
+    void sampleGaussianNear (const State& state, double stdDev, State& outState) const
+    { sampleGaussianNear(state, stdDev, outState, _rng); }
+
+    void sampleGaussianNear (const State& state, double stdDev, State& outState, RandomNumberGenerator& rng) const
+    { outState.turns = static_cast<WordType>(state.turns + State::unitsFromRadians(rng.realNormal(0.0, stdDev))); }
+
+    void sampleFromUnitCube (const double* unitCoords, State& outState) const
+    { outState.turns = static_cast<WordType>(static_cast<std::uint64_t>(unitCoords[0]*(std::uint64_t{1} << State::kNumBits))); }
+
+    double distance (const State& fromState, const State& toState) const
+    {
+      const WordType delta = static_cast<WordType>(fromState.turns - toState.turns);
+      return std::min(delta, static_cast<WordType>(0u - delta))*State::kRadiansPerUnit;
+    }
+
+    void distanceMany (const State& fromState, const State* toStates, std::size_t numStates, double* outDistances) const
+    {
+      const WordType from = fromState.turns;
+      for (std::size_t idx = 0; idx < numStates; ++idx) {
+        const WordType delta = static_cast<WordType>(from - toStates[idx].turns);
+        outDistances[idx] = std::min(delta, static_cast<WordType>(0u - delta))*State::kRadiansPerUnit;
+      }
+    }
+
+    State interpolate (const State& fromState, const State& toState, double tt) const
+    {
+      State newState;
+      interpolate(fromState, toState, tt, newState);
+      return newState;
+    }
+
+    //
+    // The signed difference of the words is the shortest way
+    // around, and adding a fraction of it wraps on its own.  States
+    // exactly half a turn apart are interpolated the negative way
+    // round.
+    //
+    void interpolate (const State& fromState, const State& toState, double tt, State& outState) const
+    {
+      const SignedWordType delta = static_cast<SignedWordType>(static_cast<WordType>(toState.turns - fromState.turns));
+      outState.turns = static_cast<WordType>(fromState.turns + static_cast<WordType>(std::llround(delta*tt)));
+    }
+
+    bool satisfiesBounds (const State&) const
+    { return true; }
+
+    void enforceBounds (State&) const
+    { }
+
+    unsigned int getDimension () const
+    { return 1; }
+
+    double getMaximumExtent () const
+    { return boost::math::double_constants::pi; }
+
+    double getMeasure () const
+    { return boost::math::double_constants::two_pi; }
+
+    friend void draw (const FixedPointSpace&, std::ostream& ostr, std::size_t indent)
+    { ostr << std::string(indent, ' ') << "SO2::FixedPointSpace<" << State::kNumBits << ">" << std::endl; }
+
+  private:
+    mutable RandomNumberGenerator _rng;
+  };
+
+  typedef FixedPointState<std::uint16_t> State16;
+  typedef FixedPointSpace<std::uint16_t> Space16;
+  typedef FixedPointState<std::uint32_t> State32;
+  typedef FixedPointSpace<std::uint32_t> Space32;
+}
+
+#endif // __SO2_FIXED_POINT_STATE_SPACE_H__
@@ -1,10 +1,41 @@
 #include "So2StateSpace.h"
 
 #include <boost/math/constants/constants.hpp>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 using namespace boost::math::double_constants;
 
+namespace
+{
+  //
+  // Branchless wrap of any angle into [-pi, pi).  The final
+  // correction catches the rounding case where x is just below
+  // pi and the floor overshoots.
+  //
+  inline double wrapAngle (double xx)
+  {
+    double wrapped = xx - two_pi*std::floor((xx + pi)*one_div_two_pi);
+    return wrapped + ((wrapped < -pi) ? two_pi : 0.0);
+  }
+
+  //
+  // Shortest signed difference from -> to, in [-pi, pi).
+  //
+  inline double angleDifference (double from, double to)
+  {
+    double delta = to - from;
+    return delta - two_pi*std::floor(delta*one_div_two_pi + 0.5);
+  }
+
+  //
+  // Block size for the random offsets of the batch samplers and for
+  // the gather/scatter (pointer-array) kernels.
+  //
+  constexpr std::size_t kBlockSize = 256;
+}
+
 namespace SO2
 {
   //////////
@@ -17,6 +48,10 @@ namespace SO2
   // Space
   //////////
 
+  Space::Space (const RandomNumberGenerator& rng)
+    : _rng{rng}
+  { }
+
   State Space::makeState () const
   { return State{}; }
 
@@ -28,7 +63,10 @@ namespace SO2
   }
 
   void Space::sampleUniform (State& outState) const
-  { outState = State{_rng.realUniform_negPi_pi()}; }
+  { sampleUniform(outState, _rng); }
+
+  void Space::sampleUniform (State& outState, RandomNumberGenerator& rng) const
+  { outState = State{rng.realUniform_negPi_pi()}; }
 
   State Space::sampleUniformNear (const State& state, double radius) const
   {
@@ -38,9 +76,12 @@ namespace SO2
   }
 
   void  Space::sampleUniformNear (const State& state, double radius, State& outState) const
+  { sampleUniformNear(state, radius, outState, _rng); }
+
+  void  Space::sampleUniformNear (const State& state, double radius, State& outState, RandomNumberGenerator& rng) const
   {
     // It _might_ be faster to avoid a constructor call here.
-    outState = State{state.theta_rad + radius*(-1.0 + 2.0*_rng.realUniform_0_1())};
+    outState = State{state.theta_rad + radius*(-1.0 + 2.0*rng.realUniform_0_1())};
     enforceBounds(outState);
   }
 
@@ -52,18 +93,43 @@ namespace SO2
   }
 
   void  Space::sampleGaussianNear (const State& state, double stddev, State& outState) const
+  { sampleGaussianNear(state, stddev, outState, _rng); }
+
+  void  Space::sampleGaussianNear (const State& state, double stddev, State& outState, RandomNumberGenerator& rng) const
   {
     // It _might_ be faster to avoid a constructor call here.
-    outState = State{state.theta_rad + _rng.realNormal(0.0, stddev)};
+    outState = State{state.theta_rad + rng.realNormal(0.0, stddev)};
     enforceBounds(outState);
   }
 
+  void Space::sampleFromUnitCube (const double* unitCoords, State& outState) const
+  { outState = State{-pi + two_pi*unitCoords[0]}; }
+
   double Space::distance (const State& fromState, const State& toState) const
   {
     double dist = fabs(fromState.theta_rad - toState.theta_rad);
     return (dist > pi) ? (two_pi - dist) : dist;
   }
 
+  void Space::distanceMany (const State& fromState, const State* toStates, std::size_t numStates, double* outDistances) const
+  {
+    const double from = fromState.theta_rad;
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      double dist = std::fabs(from - toStates[idx].theta_rad);
+      outDistances[idx] = std::min(dist, two_pi - dist);
+    }
+  }
+
+  void Space::distanceMany (const State& fromState, const StateBatch& toStates, double* outDistances) const
+  {
+    const double  from = fromState.theta_rad;
+    const double* to   = toStates.theta_rad.data();
+    for (std::size_t idx = 0; idx < toStates.size(); ++idx) {
+      double dist = std::fabs(from - to[idx]);
+      outDistances[idx] = std::min(dist, two_pi - dist);
+    }
+  }
+
   State Space::interpolate (const State& fromState, const State& toState, double tt) const
   {
     State newState;
@@ -73,7 +139,7 @@ namespace SO2
 
   void  Space::interpolate (const State& fromState, const State& toState, double tt, State& outState) const
   {
-    double deltaTheta_rad = fromState.theta_rad - toState.theta_rad;
+    double deltaTheta_rad = toState.theta_rad - fromState.theta_rad;
     if (fabs(deltaTheta_rad) <= pi) {
       outState.theta_rad = fromState.theta_rad + deltaTheta_rad * tt;
     }
@@ -116,6 +182,163 @@ namespace SO2
     }
   }
 
+  void Space::sampleUniform (std::size_t numStates, StateBatch& outStates) const
+  { sampleUniform(numStates, outStates, _rng); }
+
+  void Space::sampleUniform (std::size_t numStates, StateBatch& outStates, RandomNumberGenerator& rng) const
+  {
+    outStates.resize(numStates);
+    rng.realUniform_negPi_pi(outStates.theta_rad.data(), numStates);
+  }
+
+  void Space::sampleUniformNear (const StateBatch& states, double radius, StateBatch& outStates) const
+  { sampleUniformNear(states, radius, outStates, _rng); }
+
+  void Space::sampleUniformNear (const StateBatch& states, double radius, StateBatch& outStates, RandomNumberGenerator& rng) const
+  {
+    const std::size_t numStates = states.size();
+    outStates.resize(numStates);
+
+    //
+    // Each block reads its input before writing its output, so
+    // outStates may alias states.
+    //
+    const double* in  = states.theta_rad.data();
+    double*       out = outStates.theta_rad.data();
+    alignas(64) double offsets[kBlockSize];
+    for (std::size_t begin = 0; begin < numStates; begin += kBlockSize) {
+      const std::size_t count = std::min(kBlockSize, numStates - begin);
+      rng.realUniform(-radius, radius, offsets, count);
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        out[begin + idx] = wrapAngle(in[begin + idx] + offsets[idx]);
+      }
+    }
+  }
+
+  void Space::sampleGaussianNear (const StateBatch& states, double stddev, StateBatch& outStates) const
+  { sampleGaussianNear(states, stddev, outStates, _rng); }
+
+  void Space::sampleGaussianNear (const StateBatch& states, double stddev, StateBatch& outStates, RandomNumberGenerator& rng) const
+  {
+    const std::size_t numStates = states.size();
+    outStates.resize(numStates);
+
+    const double* in  = states.theta_rad.data();
+    double*       out = outStates.theta_rad.data();
+    alignas(64) double offsets[kBlockSize];
+    for (std::size_t begin = 0; begin < numStates; begin += kBlockSize) {
+      const std::size_t count = std::min(kBlockSize, numStates - begin);
+      rng.realNormal(0.0, stddev, offsets, count);
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        out[begin + idx] = wrapAngle(in[begin + idx] + offsets[idx]);
+      }
+    }
+  }
+
+  void Space::interpolate (const StateBatch& fromStates, const StateBatch& toStates, double tt, StateBatch& outStates) const
+  {
+    const std::size_t numStates = fromStates.size();
+    outStates.resize(numStates);
+
+    const double* from = fromStates.theta_rad.data();
+    const double* to   = toStates.theta_rad.data();
+    double*       out  = outStates.theta_rad.data();
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      out[idx] = wrapAngle(from[idx] + angleDifference(from[idx], to[idx])*tt);
+    }
+  }
+
+  bool Space::satisfiesBounds (const StateBatch& states) const
+  {
+    const double* in = states.theta_rad.data();
+    int allInBounds = 1;
+    for (std::size_t idx = 0; idx < states.size(); ++idx) {
+      allInBounds &= (in[idx] < pi) & (in[idx] >= -pi);
+    }
+    return allInBounds;
+  }
+
+  void Space::enforceBounds (StateBatch& states) const
+  {
+    double* inOut = states.theta_rad.data();
+    for (std::size_t idx = 0; idx < states.size(); ++idx) {
+      inOut[idx] = wrapAngle(inOut[idx]);
+    }
+  }
+
+  void Space::sampleUniformMany (State* const* outStates, std::size_t numStates, RandomNumberGenerator& rng) const
+  {
+    alignas(64) double block[kBlockSize];
+    for (std::size_t begin = 0; begin < numStates; begin += kBlockSize) {
+      const std::size_t count = std::min(kBlockSize, numStates - begin);
+      rng.realUniform_negPi_pi(block, count);
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        outStates[begin + idx]->theta_rad = block[idx];
+      }
+    }
+  }
+
+  void Space::sampleUniformNearMany (const State* const* states, double radius, State* const* outStates, std::size_t numStates, RandomNumberGenerator& rng) const
+  {
+    alignas(64) double block[kBlockSize];
+    for (std::size_t begin = 0; begin < numStates; begin += kBlockSize) {
+      const std::size_t count = std::min(kBlockSize, numStates - begin);
+      rng.realUniform(-radius, radius, block, count);
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        block[idx] += states[begin + idx]->theta_rad;
+      }
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        outStates[begin + idx]->theta_rad = wrapAngle(block[idx]);
+      }
+    }
+  }
+
+  void Space::sampleGaussianNearMany (const State* const* states, double stddev, State* const* outStates, std::size_t numStates, RandomNumberGenerator& rng) const
+  {
+    alignas(64) double block[kBlockSize];
+    for (std::size_t begin = 0; begin < numStates; begin += kBlockSize) {
+      const std::size_t count = std::min(kBlockSize, numStates - begin);
+      rng.realNormal(0.0, stddev, block, count);
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        block[idx] += states[begin + idx]->theta_rad;
+      }
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        outStates[begin + idx]->theta_rad = wrapAngle(block[idx]);
+      }
+    }
+  }
+
+  void Space::distanceMany (const State& fromState, const State* const* toStates, std::size_t numStates, double* outDistances) const
+  {
+    const double from = fromState.theta_rad;
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      outDistances[idx] = toStates[idx]->theta_rad;
+    }
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      double dist = std::fabs(from - outDistances[idx]);
+      outDistances[idx] = std::min(dist, two_pi - dist);
+    }
+  }
+
+  void Space::interpolateMany (const State* const* fromStates, const State* const* toStates, std::size_t numStates, double tt, State* const* outStates) const
+  {
+    alignas(64) double from[kBlockSize];
+    alignas(64) double to[kBlockSize];
+    for (std::size_t begin = 0; begin < numStates; begin += kBlockSize) {
+      const std::size_t count = std::min(kBlockSize, numStates - begin);
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        from[idx] = fromStates[begin + idx]->theta_rad;
+        to[idx]   = toStates[begin + idx]->theta_rad;
+      }
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        from[idx] = wrapAngle(from[idx] + angleDifference(from[idx], to[idx])*tt);
+      }
+      for (std::size_t idx = 0; idx < count; ++idx) {
+        outStates[begin + idx]->theta_rad = from[idx];
+      }
+    }
+  }
+
   unsigned int Space::getDimension() const
   { return 1; }
 
@@ -124,4 +347,16 @@ namespace SO2
 
   double Space::getMeasure() const
   { return two_pi; }
+
+  void Space::appendSchema (std::string& schema) const
+  { schema += "SO2"; }
+
+  std::size_t Space::getSerializationSize () const
+  { return sizeof(double); }
+
+  void Space::serialize (const State& state, unsigned char* outBytes) const
+  { std::memcpy(outBytes, &state.theta_rad, sizeof(double)); }
+
+  void Space::deserialize (const unsigned char* bytes, State& outState) const
+  { std::memcpy(&outState.theta_rad, bytes, sizeof(double)); }
 }
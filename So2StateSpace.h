@@ -1,8 +1,12 @@
 #ifndef __SO2_STATE_SPACE_H__
 #define __SO2_STATE_SPACE_H__
 
+#include "AlignedAllocator.h"
 #include "RandomNumberGenerator.h"
 
+#include <cstddef>
+#include <string>
+
 namespace SO2
 {
   class State
@@ -20,53 +24,160 @@ namespace SO2
     double theta_rad;
   };
 
+  //
+  // Structure-of-arrays storage for many states, used by the
+  // batch overloads on Space.  The angles are contiguous and
+  // cache-line aligned so the batch kernels vectorize.
+  //
+  class StateBatch
+  {
+  public:
+    typedef State StateType;
+
+    explicit StateBatch (std::size_t size=0)
+      : theta_rad(size)
+    { }
+    StateBatch (const StateBatch& orig)            = default;
+    StateBatch& operator= (const StateBatch& orig) = default;
+    ~StateBatch ()                                 = default;
+
+    std::size_t size () const
+    { return theta_rad.size(); }
+
+    void resize (std::size_t size)
+    { theta_rad.resize(size); }
+
+    State get (std::size_t idx) const
+    { return State{theta_rad[idx]}; }
+
+    void set (std::size_t idx, const State& state)
+    { theta_rad[idx] = state.theta_rad; }
+
+    AlignedVector<double> theta_rad;
+  };
+
   class Space
   {
   public:
     typedef State StateType;
 
     Space ()                            = default;
+    explicit Space (const RandomNumberGenerator& rng);
     Space (const Space& orig)           = default;
     Space& operator=(const Space& orig) = default;
     ~Space ()                           = default;
 
     State makeState () const;
 
+    //
+    // The sampling calls that take a RandomNumberGenerator draw from
+    // that stream instead of the space's own, so one space can be
+    // shared by several workers that each own a stream.
+    //
+
     State sampleUniform () const;
     void  sampleUniform (State& outState) const;
+    void  sampleUniform (State& outState, RandomNumberGenerator& rng) const;
 
     State sampleUniformNear (const State& state, double radius) const;
     void  sampleUniformNear (const State& state, double radius, State& outState) const;
+    void  sampleUniformNear (const State& state, double radius, State& outState, RandomNumberGenerator& rng) const;
 
     State sampleGaussianNear (const State& state, double stdDev) const;
     void  sampleGaussianNear (const State& state, double stdDev, State& outState) const;
+    void  sampleGaussianNear (const State& state, double stdDev, State& outState, RandomNumberGenerator& rng) const;
+
+    //
+    // Map a point of the unit cube [0,1)^getDimension() to a state,
+    // uniformly.  Used to drive the space with quasi-random sequences.
+    //
+    void sampleFromUnitCube (const double* unitCoords, State& outState) const;
 
     double distance (const State& fromState, const State& toState) const;
 
+    //
+    // One-to-many distance: outDistances[i] = distance(fromState, toStates[i]).
+    // Branchless, so a contiguous array of states is scanned in one
+    // vectorized pass (this is what nearest-neighbor leaf scans use).
+    //
+    void distanceMany (const State& fromState, const State* toStates, std::size_t numStates, double* outDistances) const;
+    void distanceMany (const State& fromState, const StateBatch& toStates, double* outDistances) const;
+
     State interpolate (const State& state1, const State& state2, double tt) const;
     void  interpolate (const State& state1, const State& state2, double tt, State& outState) const;
 
     bool satisfiesBounds(const State& state) const;
     void enforceBounds  (State& state) const;
 
+    //
+    // Batch versions of the above.  Each operates element-wise on
+    // whole batches with branchless wrap-around arithmetic (no fmod).
+    // Output batches are resized to match the input batch, or to
+    // numStates for sampleUniform, and may be the same object as the
+    // input.
+    //
+
+    void sampleUniform (std::size_t numStates, StateBatch& outStates) const;
+    void sampleUniform (std::size_t numStates, StateBatch& outStates, RandomNumberGenerator& rng) const;
+
+    void sampleUniformNear (const StateBatch& states, double radius, StateBatch& outStates) const;
+    void sampleUniformNear (const StateBatch& states, double radius, StateBatch& outStates, RandomNumberGenerator& rng) const;
+
+    void sampleGaussianNear (const StateBatch& states, double stdDev, StateBatch& outStates) const;
+    void sampleGaussianNear (const StateBatch& states, double stdDev, StateBatch& outStates, RandomNumberGenerator& rng) const;
+
+    void interpolate (const StateBatch& fromStates, const StateBatch& toStates, double tt, StateBatch& outStates) const;
+
+    bool satisfiesBounds (const StateBatch& states) const;
+    void enforceBounds   (StateBatch& states) const;
+
+    //
+    // Pointer-array versions, for states that are not stored together
+    // (e.g. the SO2 substates of many compound states).  Each gathers
+    // the angles into a local block, runs the batch kernel on it and
+    // scatters the results back.  outStates may alias states.
+    //
+
+    void sampleUniformMany      (State* const* outStates, std::size_t numStates, RandomNumberGenerator& rng) const;
+    void sampleUniformNearMany  (const State* const* states, double radius, State* const* outStates, std::size_t numStates, RandomNumberGenerator& rng) const;
+    void sampleGaussianNearMany (const State* const* states, double stdDev, State* const* outStates, std::size_t numStates, RandomNumberGenerator& rng) const;
+
+    void distanceMany    (const State& fromState, const State* const* toStates, std::size_t numStates, double* outDistances) const;
+    void interpolateMany (const State* const* fromStates, const State* const* toStates, std::size_t numStates, double tt, State* const* outStates) const;
+
     unsigned int getDimension() const;
 
     double getMaximumExtent() const;
 
     double getMeasure() const;
 
+    //
+    // Binary serialization.  Each state takes getSerializationSize()
+    // bytes (its angle, in host byte order); the schema string names
+    // the format so stored states can be checked against a space.
+    //
+    void        appendSchema (std::string& schema) const;
+    std::size_t getSerializationSize () const;
+    void        serialize   (const State& state, unsigned char* outBytes) const;
+    void        deserialize (const unsigned char* bytes, State& outState) const;
+
   private:
     mutable RandomNumberGenerator _rng;
   };
-}
 
-static bool operator==(const SO2::State& lhs, const SO2::State& rhs)
-{ return lhs.theta_rad == rhs.theta_rad; }
+  //
+  // Declared in namespace SO2 so that argument-dependent lookup finds
+  // them from generic code (e.g. compound states).
+  //
+
+  inline bool operator==(const State& lhs, const State& rhs)
+  { return lhs.theta_rad == rhs.theta_rad; }
 
-static bool operator!=(const SO2::State& lhs, const SO2::State& rhs)
-{ return !(lhs == rhs); }
+  inline bool operator!=(const State& lhs, const State& rhs)
+  { return !(lhs == rhs); }
 
-static bool operator<(const SO2::State& lhs, const SO2::State& rhs)
-{ return lhs.theta_rad < rhs.theta_rad; }
+  inline bool operator<(const State& lhs, const State& rhs)
+  { return lhs.theta_rad < rhs.theta_rad; }
+}
 
 #endif // __SO2_STATE_SPACE_H__
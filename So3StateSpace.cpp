@@ -0,0 +1,384 @@
+#include "So3StateSpace.h"
+
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <tuple>
+
+using namespace boost::math::double_constants;
+
+namespace
+{
+  //
+  // Largest deviation of a quaternion's norm from 1
+  // that still counts as satisfying the bounds.
+  //
+  constexpr double kMaxNormError = 1e-9;
+
+  // Angles below this are treated as zero.
+  constexpr double kEpsilon = 1e-12;
+
+  SO3::State product (const SO3::State& q0, const SO3::State& q1)
+  {
+    return SO3::State{q0.w*q1.x + q0.x*q1.w + q0.y*q1.z - q0.z*q1.y,
+                      q0.w*q1.y + q0.y*q1.w + q0.z*q1.x - q0.x*q1.z,
+                      q0.w*q1.z + q0.z*q1.w + q0.x*q1.y - q0.y*q1.x,
+                      q0.w*q1.w - q0.x*q1.x - q0.y*q1.y - q0.z*q1.z};
+  }
+
+  double dot (const SO3::State& q0, const SO3::State& q1)
+  { return q0.x*q1.x + q0.y*q1.y + q0.z*q1.z + q0.w*q1.w; }
+
+  //
+  // Rotation by angle about the (unnormalized) axis (ax, ay, az).
+  //
+  SO3::State fromAxisAngle (double ax, double ay, double az, double angle)
+  {
+    const double norm = std::sqrt(ax*ax + ay*ay + az*az);
+    if (norm < kEpsilon) {
+      return SO3::State{};
+    }
+    const double halfAngle = 0.5*angle;
+    const double ss        = std::sin(halfAngle) / norm;
+    return SO3::State{ss*ax, ss*ay, ss*az, std::cos(halfAngle)};
+  }
+
+  //
+  // Shoemake, "Uniform random rotations" (Graphics Gems III).
+  //
+  SO3::State shoemake (double u1, double u2, double u3)
+  {
+    const double r1     = std::sqrt(1.0 - u1);
+    const double r2     = std::sqrt(u1);
+    const double theta1 = two_pi*u2;
+    const double theta2 = two_pi*u3;
+    return SO3::State{std::sin(theta1)*r1, std::cos(theta1)*r1, std::sin(theta2)*r2, std::cos(theta2)*r2};
+  }
+}
+
+namespace SO3
+{
+  //////////
+  // State
+  //////////
+
+  void draw (const State& state, std::ostream& ostr, std::size_t indent)
+  {
+    ostr << std::string(indent, ' ') << "SO3::State ("
+         << state.x << ", " << state.y << ", " << state.z << ", " << state.w << ")" << std::endl;
+  }
+
+  bool operator== (const State& lhs, const State& rhs)
+  { return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z && lhs.w == rhs.w; }
+
+  bool operator!= (const State& lhs, const State& rhs)
+  { return !(lhs == rhs); }
+
+  bool operator< (const State& lhs, const State& rhs)
+  { return std::tie(lhs.x, lhs.y, lhs.z, lhs.w) < std::tie(rhs.x, rhs.y, rhs.z, rhs.w); }
+
+  //////////
+  // StateBatch
+  //////////
+
+  StateBatch::StateBatch (std::size_t size)
+    : x(size, 0.0)
+    , y(size, 0.0)
+    , z(size, 0.0)
+    , w(size, 1.0)
+  { }
+
+  std::size_t StateBatch::size () const
+  { return w.size(); }
+
+  void StateBatch::resize (std::size_t size)
+  {
+    x.resize(size, 0.0);
+    y.resize(size, 0.0);
+    z.resize(size, 0.0);
+    w.resize(size, 1.0);
+  }
+
+  State StateBatch::get (std::size_t idx) const
+  { return State{x[idx], y[idx], z[idx], w[idx]}; }
+
+  void StateBatch::set (std::size_t idx, const State& state)
+  {
+    x[idx] = state.x;
+    y[idx] = state.y;
+    z[idx] = state.z;
+    w[idx] = state.w;
+  }
+
+  //////////
+  // Space
+  //////////
+
+  Space::Space (const RandomNumberGenerator& rng)
+    : _rng{rng}
+  { }
+
+  State Space::makeState () const
+  { return State{}; }
+
+  State Space::sampleUniform () const
+  {
+    State outState;
+    sampleUniform(outState);
+    return outState;
+  }
+
+  void Space::sampleUniform (State& outState) const
+  { sampleUniform(outState, _rng); }
+
+  void Space::sampleUniform (State& outState, RandomNumberGenerator& rng) const
+  {
+    double unit[3];
+    rng.realUniform_0_1(unit, 3);
+    outState = shoemake(unit[0], unit[1], unit[2]);
+  }
+
+  State Space::sampleUniformNear (const State& state, double radius) const
+  {
+    State newState;
+    sampleUniformNear(state, radius, newState);
+    return newState;
+  }
+
+  void Space::sampleUniformNear (const State& state, double radius, State& outState) const
+  { sampleUniformNear(state, radius, outState, _rng); }
+
+  void Space::sampleUniformNear (const State& state, double radius, State& outState, RandomNumberGenerator& rng) const
+  {
+    if (radius >= 0.25*pi) {
+      sampleUniform(outState, rng);
+      return;
+    }
+
+    //
+    // Random axis (isotropic Gaussian direction) and an angle whose
+    // cube-root scaling spreads samples evenly through the ball.
+    //
+    double axis[3];
+    rng.realNormal_0_1(axis, 3);
+    const double angle = 2.0*std::cbrt(rng.realUniform_0_1())*radius;
+    outState = product(state, fromAxisAngle(axis[0], axis[1], axis[2], angle));
+  }
+
+  State Space::sampleGaussianNear (const State& state, double stddev) const
+  {
+    State newState;
+    sampleGaussianNear(state, stddev, newState);
+    return newState;
+  }
+
+  void Space::sampleGaussianNear (const State& state, double stddev, State& outState) const
+  { sampleGaussianNear(state, stddev, outState, _rng); }
+
+  void Space::sampleGaussianNear (const State& state, double stddev, State& outState, RandomNumberGenerator& rng) const
+  {
+    if (stddev > 0.25*pi) {
+      sampleUniform(outState, rng);
+      return;
+    }
+
+    //
+    // Gaussian rotation vector, mapped through the exponential map.
+    //
+    double rotation[3];
+    rng.realNormal(0.0, stddev, rotation, 3);
+    const double theta = std::sqrt(rotation[0]*rotation[0] + rotation[1]*rotation[1] + rotation[2]*rotation[2]);
+    if (theta < kEpsilon) {
+      outState = state;
+      return;
+    }
+    outState = product(state, fromAxisAngle(rotation[0], rotation[1], rotation[2], theta));
+  }
+
+  void Space::sampleFromUnitCube (const double* unitCoords, State& outState) const
+  { outState = shoemake(unitCoords[0], unitCoords[1], unitCoords[2]); }
+
+  double Space::distance (const State& fromState, const State& toState) const
+  { return std::acos(std::min(1.0, std::fabs(dot(fromState, toState)))); }
+
+  double Space::distanceLowerBound (const State& fromState, const State& toState) const
+  { return std::sqrt(2.0*std::max(0.0, 1.0 - std::fabs(dot(fromState, toState)))); }
+
+  void Space::distanceMany (const State& fromState, const State* toStates, std::size_t numStates, double* outDistances) const
+  {
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      outDistances[idx] = std::acos(std::min(1.0, std::fabs(dot(fromState, toStates[idx]))));
+    }
+  }
+
+  void Space::distanceMany (const State& fromState, const StateBatch& toStates, double* outDistances) const
+  {
+    const std::size_t numStates = toStates.size();
+    const double* tx = toStates.x.data();
+    const double* ty = toStates.y.data();
+    const double* tz = toStates.z.data();
+    const double* tw = toStates.w.data();
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      const double cosTheta = fromState.x*tx[idx] + fromState.y*ty[idx] + fromState.z*tz[idx] + fromState.w*tw[idx];
+      outDistances[idx] = std::acos(std::min(1.0, std::fabs(cosTheta)));
+    }
+  }
+
+  void Space::distanceLowerBoundMany (const State& fromState, const StateBatch& toStates, double* outDistances) const
+  {
+    const std::size_t numStates = toStates.size();
+    const double* tx = toStates.x.data();
+    const double* ty = toStates.y.data();
+    const double* tz = toStates.z.data();
+    const double* tw = toStates.w.data();
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      const double cosTheta = fromState.x*tx[idx] + fromState.y*ty[idx] + fromState.z*tz[idx] + fromState.w*tw[idx];
+      outDistances[idx] = std::sqrt(2.0*std::max(0.0, 1.0 - std::fabs(cosTheta)));
+    }
+  }
+
+  State Space::interpolate (const State& fromState, const State& toState, double tt) const
+  {
+    State newState;
+    interpolate(fromState, toState, tt, newState);
+    return newState;
+  }
+
+  void Space::interpolate (const State& fromState, const State& toState, double tt, State& outState) const
+  {
+    const double cosTheta = dot(fromState, toState);
+    const double theta    = std::acos(std::min(1.0, std::fabs(cosTheta)));
+    if (theta < kEpsilon) {
+      outState = fromState;
+      return;
+    }
+
+    //
+    // Slerp along the shorter arc: if the quaternions are in
+    // opposite hemispheres, interpolate towards -toState.
+    //
+    const double scale = 1.0 / std::sin(theta);
+    const double s0    = std::sin((1.0 - tt)*theta)*scale;
+    const double s1    = std::copysign(std::sin(tt*theta)*scale, cosTheta);
+    outState = State{s0*fromState.x + s1*toState.x,
+                     s0*fromState.y + s1*toState.y,
+                     s0*fromState.z + s1*toState.z,
+                     s0*fromState.w + s1*toState.w};
+  }
+
+  bool Space::satisfiesBounds (const State& state) const
+  { return std::fabs(std::sqrt(dot(state, state)) - 1.0) < kMaxNormError; }
+
+  void Space::enforceBounds (State& state) const
+  {
+    const double norm = std::sqrt(dot(state, state));
+    if (norm < kEpsilon) {
+      state = State{};
+      return;
+    }
+    state.x /= norm;
+    state.y /= norm;
+    state.z /= norm;
+    state.w /= norm;
+  }
+
+  void Space::sampleUniform (std::size_t numStates, StateBatch& outStates) const
+  { sampleUniform(numStates, outStates, _rng); }
+
+  void Space::sampleUniform (std::size_t numStates, StateBatch& outStates, RandomNumberGenerator& rng) const
+  {
+    //
+    // Draw the three Shoemake uniforms straight into x, y and z,
+    // then transform all four columns in place.
+    //
+    outStates.resize(numStates);
+    double* xx = outStates.x.data();
+    double* yy = outStates.y.data();
+    double* zz = outStates.z.data();
+    double* ww = outStates.w.data();
+    rng.realUniform_0_1(xx, numStates);
+    rng.realUniform_0_1(yy, numStates);
+    rng.realUniform_0_1(zz, numStates);
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      const double r1     = std::sqrt(1.0 - xx[idx]);
+      const double r2     = std::sqrt(xx[idx]);
+      const double theta1 = two_pi*yy[idx];
+      const double theta2 = two_pi*zz[idx];
+      xx[idx] = std::sin(theta1)*r1;
+      yy[idx] = std::cos(theta1)*r1;
+      zz[idx] = std::sin(theta2)*r2;
+      ww[idx] = std::cos(theta2)*r2;
+    }
+  }
+
+  void Space::interpolate (const StateBatch& fromStates, const StateBatch& toStates, double tt, StateBatch& outStates) const
+  {
+    const std::size_t numStates = fromStates.size();
+    outStates.resize(numStates);
+
+    const double* fx = fromStates.x.data();
+    const double* fy = fromStates.y.data();
+    const double* fz = fromStates.z.data();
+    const double* fw = fromStates.w.data();
+    const double* tx = toStates.x.data();
+    const double* ty = toStates.y.data();
+    const double* tz = toStates.z.data();
+    const double* tw = toStates.w.data();
+    double*       ox = outStates.x.data();
+    double*       oy = outStates.y.data();
+    double*       oz = outStates.z.data();
+    double*       ow = outStates.w.data();
+
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      const double cosTheta = fx[idx]*tx[idx] + fy[idx]*ty[idx] + fz[idx]*tz[idx] + fw[idx]*tw[idx];
+      const double theta    = std::acos(std::min(1.0, std::fabs(cosTheta)));
+
+      //
+      // Both weightings are computed and the linear one is selected
+      // for (nearly) identical rotations, where slerp divides by ~0.
+      //
+      const bool   isSmall = theta < kEpsilon;
+      const double scale   = 1.0 / std::sin(isSmall ? 1.0 : theta);
+      const double s0      = isSmall ? (1.0 - tt) : std::sin((1.0 - tt)*theta)*scale;
+      const double s1      = std::copysign(isSmall ? tt : std::sin(tt*theta)*scale, cosTheta);
+
+      ox[idx] = s0*fx[idx] + s1*tx[idx];
+      oy[idx] = s0*fy[idx] + s1*ty[idx];
+      oz[idx] = s0*fz[idx] + s1*tz[idx];
+      ow[idx] = s0*fw[idx] + s1*tw[idx];
+    }
+  }
+
+  unsigned int Space::getDimension () const
+  { return 3; }
+
+  double Space::getMaximumExtent () const
+  { return half_pi; }
+
+  double Space::getMeasure () const
+  { return pi*pi; }
+
+  void Space::appendSchema (std::string& schema) const
+  { schema += "SO3"; }
+
+  std::size_t Space::getSerializationSize () const
+  { return 4*sizeof(double); }
+
+  void Space::serialize (const State& state, unsigned char* outBytes) const
+  {
+    const double values[4] = {state.x, state.y, state.z, state.w};
+    std::memcpy(outBytes, values, sizeof(values));
+  }
+
+  void Space::deserialize (const unsigned char* bytes, State& outState) const
+  {
+    double values[4];
+    std::memcpy(values, bytes, sizeof(values));
+    outState = State{values[0], values[1], values[2], values[3]};
+  }
+
+  void draw (const Space&, std::ostream& ostr, std::size_t indent)
+  { ostr << std::string(indent, ' ') << "SO3::Space" << std::endl; }
+}
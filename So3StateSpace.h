@@ -0,0 +1,153 @@
+#ifndef __SO3_STATE_SPACE_H__
+#define __SO3_STATE_SPACE_H__
+
+#include "AlignedAllocator.h"
+#include "RandomNumberGenerator.h"
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace SO3
+{
+  //
+  // A rotation as a unit quaternion (x, y, z, w).  q and -q are the
+  // same rotation; every operation below accounts for that.
+  //
+  class State
+  {
+  public:
+    typedef State StateType;
+
+    State (double x_=0.0, double y_=0.0, double z_=0.0, double w_=1.0)
+      : x{x_}
+      , y{y_}
+      , z{z_}
+      , w{w_}
+    { }
+    State (const State& orig)            = default;
+    State& operator= (const State& orig) = default;
+    ~State ()                            = default;
+
+    friend void draw (const State& state, std::ostream& ostr, std::size_t indent);
+
+    alignas(32) double x;
+    double y;
+    double z;
+    double w;
+  };
+
+  bool operator== (const State& lhs, const State& rhs);
+  bool operator!= (const State& lhs, const State& rhs);
+  bool operator<  (const State& lhs, const State& rhs);
+
+  //
+  // Structure-of-arrays storage for many rotations, used by the
+  // batch overloads on Space.
+  //
+  class StateBatch
+  {
+  public:
+    typedef State StateType;
+
+    explicit StateBatch (std::size_t size=0);
+    StateBatch (const StateBatch& orig)            = default;
+    StateBatch& operator= (const StateBatch& orig) = default;
+    ~StateBatch ()                                 = default;
+
+    std::size_t size () const;
+    void        resize (std::size_t size);
+
+    State get (std::size_t idx) const;
+    void  set (std::size_t idx, const State& state);
+
+    AlignedVector<double> x;
+    AlignedVector<double> y;
+    AlignedVector<double> z;
+    AlignedVector<double> w;
+  };
+
+  class Space
+  {
+  public:
+    typedef State StateType;
+
+    Space ()                            = default;
+    explicit Space (const RandomNumberGenerator& rng);
+    Space (const Space& orig)           = default;
+    Space& operator=(const Space& orig) = default;
+    ~Space ()                           = default;
+
+    State makeState () const;
+
+    //
+    // Uniform sampling uses Shoemake's method.  The near samplers
+    // compose the given rotation with a small random rotation and
+    // fall back to uniform sampling for radii beyond pi/4.
+    //
+
+    State sampleUniform () const;
+    void  sampleUniform (State& outState) const;
+    void  sampleUniform (State& outState, RandomNumberGenerator& rng) const;
+
+    State sampleUniformNear (const State& state, double radius) const;
+    void  sampleUniformNear (const State& state, double radius, State& outState) const;
+    void  sampleUniformNear (const State& state, double radius, State& outState, RandomNumberGenerator& rng) const;
+
+    State sampleGaussianNear (const State& state, double stdDev) const;
+    void  sampleGaussianNear (const State& state, double stdDev, State& outState) const;
+    void  sampleGaussianNear (const State& state, double stdDev, State& outState, RandomNumberGenerator& rng) const;
+
+    void sampleFromUnitCube (const double* unitCoords, State& outState) const;
+
+    //
+    // distance is the geodesic angle acos(|q1.q2|), in [0, pi/2].
+    // distanceLowerBound is sqrt(2(1 - |q1.q2|)), which never exceeds
+    // it, is monotone in it and needs no acos, so it can be used to
+    // prune candidates before the exact distance is computed.
+    //
+    double distance           (const State& fromState, const State& toState) const;
+    double distanceLowerBound (const State& fromState, const State& toState) const;
+
+    void distanceMany (const State& fromState, const State* toStates, std::size_t numStates, double* outDistances) const;
+    void distanceMany (const State& fromState, const StateBatch& toStates, double* outDistances) const;
+    void distanceLowerBoundMany (const State& fromState, const StateBatch& toStates, double* outDistances) const;
+
+    State interpolate (const State& state1, const State& state2, double tt) const;
+    void  interpolate (const State& state1, const State& state2, double tt, State& outState) const;
+
+    bool satisfiesBounds (const State& state) const;
+    void enforceBounds   (State& state) const;
+
+    //
+    // Batch versions.  Output batches are resized to match the input,
+    // or to numStates for sampleUniform.  interpolate is a branchless
+    // slerp over whole batches.
+    //
+    void sampleUniform (std::size_t numStates, StateBatch& outStates) const;
+    void sampleUniform (std::size_t numStates, StateBatch& outStates, RandomNumberGenerator& rng) const;
+
+    void interpolate (const StateBatch& fromStates, const StateBatch& toStates, double tt, StateBatch& outStates) const;
+
+    unsigned int getDimension () const;
+
+    double getMaximumExtent () const;
+
+    double getMeasure () const;
+
+    //
+    // Binary serialization: x, y, z, w as doubles in host byte order.
+    //
+    void        appendSchema (std::string& schema) const;
+    std::size_t getSerializationSize () const;
+    void        serialize   (const State& state, unsigned char* outBytes) const;
+    void        deserialize (const unsigned char* bytes, State& outState) const;
+
+    friend void draw (const Space& space, std::ostream& ostr, std::size_t indent);
+
+  private:
+    mutable RandomNumberGenerator _rng;
+  };
+}
+
+#endif // __SO3_STATE_SPACE_H__
@@ -0,0 +1,23 @@
+#ifndef __SPACE_HANDLE_H__
+#define __SPACE_HANDLE_H__
+
+#include <memory>
+#include <utility>
+
+//
+// Shared, immutable reference to a space.
+//
+// Spaces describe a problem's configuration and do not change once
+// built, so samplers, validators and compound spaces can all refer to
+// one instance instead of each holding a deep copy.  Random number
+// state is not part of this: every sampler or worker keeps its own
+// RandomNumberGenerator and passes it to the space's sampling calls.
+//
+template <typename SpaceType>
+using SpaceHandle = std::shared_ptr<const SpaceType>;
+
+template <typename SpaceType>
+SpaceHandle<SpaceType> makeSpaceHandle (SpaceType space)
+{ return std::make_shared<const SpaceType>(std::move(space)); }
+
+#endif // __SPACE_HANDLE_H__
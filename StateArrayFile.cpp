@@ -0,0 +1,79 @@
+#include "StateArrayFile.h"
+
+#include <cstddef>
+#include <cstring>
+
+namespace StateArrayFormat
+{
+  namespace
+  {
+    constexpr char kMagic[8] = "OMPLSTA";
+
+    [[noreturn]] void throwFormatError (const MappedFile& file, const std::string& what)
+    { throw std::runtime_error{"state array " + file.getPath() + ": " + what}; }
+  }
+
+  std::size_t getDataOffset (const std::string& schema)
+  {
+    const std::size_t end = sizeof(Header) + schema.size();
+    return (end + kAlignment - 1)/kAlignment*kAlignment;
+  }
+
+  void writeHeader (MappedFile& file, const std::string& schema, std::size_t stateSize, std::size_t numStates)
+  {
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version      = kVersion;
+    header.byteOrderTag = kByteOrderTag;
+    header.stateSize    = stateSize;
+    header.numStates    = numStates;
+    header.schemaLength = schema.size();
+    header.dataOffset   = getDataOffset(schema);
+
+    std::memcpy(file.data(), &header, sizeof(header));
+    std::memcpy(file.data() + sizeof(header), schema.data(), schema.size());
+  }
+
+  void setNumStates (MappedFile& file, std::size_t numStates)
+  {
+    const std::uint64_t value = numStates;
+    std::memcpy(file.data() + offsetof(Header, numStates), &value, sizeof(value));
+  }
+
+  Header readHeader (const MappedFile& file, const std::string& schema, std::size_t stateSize)
+  {
+    Header header;
+    if (file.size() < sizeof(header)) {
+      throwFormatError(file, "too short for a header");
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+      throwFormatError(file, "not a state array");
+    }
+    if (header.byteOrderTag != kByteOrderTag) {
+      throwFormatError(file, "written with a different byte order");
+    }
+    if (header.version != kVersion) {
+      throwFormatError(file, "unsupported version " + std::to_string(header.version));
+    }
+    if (header.schemaLength > file.size() - sizeof(header)) {
+      throwFormatError(file, "truncated schema");
+    }
+
+    const std::string fileSchema{reinterpret_cast<const char*>(file.data()) + sizeof(header), header.schemaLength};
+    if (fileSchema != schema) {
+      throwFormatError(file, "schema " + fileSchema + " does not match space schema " + schema);
+    }
+    if (header.stateSize != stateSize) {
+      throwFormatError(file, "state size " + std::to_string(header.stateSize) +
+                             " does not match space state size " + std::to_string(stateSize));
+    }
+    if (header.dataOffset != getDataOffset(fileSchema) || header.dataOffset > file.size() ||
+        (stateSize > 0 && header.numStates > (file.size() - header.dataOffset)/stateSize)) {
+      throwFormatError(file, "truncated records");
+    }
+
+    return header;
+  }
+}
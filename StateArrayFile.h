@@ -0,0 +1,241 @@
+#ifndef __STATE_ARRAY_FILE_H__
+#define __STATE_ARRAY_FILE_H__
+
+#include "MappedFile.h"
+#include "OmplConcepts.h"
+#include "SpaceHandle.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+//
+// Arrays of states stored in a file, using the spaces' binary
+// serialization (see OmplSerializableSpace).
+//
+// The file is a 64-byte header, the space's schema string, and then,
+// from the next multiple of 64 bytes, one fixed-size record per state.
+// Records are in host byte order; the header records which one, and a
+// reader refuses files of another byte order, format version, schema
+// or record size.  Both ends map the file, so a reader can hand out
+// pointers to records without copying them.
+//
+namespace StateArrayFormat
+{
+  constexpr std::uint32_t kVersion      = 1;
+  constexpr std::uint32_t kByteOrderTag = 0x01020304;
+  constexpr std::size_t   kAlignment    = 64;
+
+  struct Header
+  {
+    char          magic[8];       // "OMPLSTA" and a null
+    std::uint32_t version;
+    std::uint32_t byteOrderTag;   // kByteOrderTag, as written by the host
+    std::uint64_t stateSize;
+    std::uint64_t numStates;
+    std::uint64_t schemaLength;
+    std::uint64_t dataOffset;
+    std::uint64_t reserved[2];
+  };
+  static_assert(sizeof(Header) == kAlignment, "the header fills the first alignment block");
+
+  // Where the records start for a given schema.
+  std::size_t getDataOffset (const std::string& schema);
+
+  // Write a header and schema to the start of file, which must be large enough.
+  void writeHeader (MappedFile& file, const std::string& schema, std::size_t stateSize, std::size_t numStates);
+
+  void setNumStates (MappedFile& file, std::size_t numStates);
+
+  //
+  // Checks that file holds records of the given schema and size and
+  // returns its header.  Throws std::runtime_error if it does not.
+  //
+  Header readHeader (const MappedFile& file, const std::string& schema, std::size_t stateSize);
+}
+
+//
+// Appends states to a new file (replacing any existing one).  The file
+// grows geometrically as states are added and is trimmed to its final
+// length, with the state count written to its header, by close or the
+// destructor.  Until then a reader sees it as empty.
+//
+template <OmplSerializableSpace SpaceType>
+class StateArrayWriter
+{
+public:
+  typedef typename SpaceType::StateType StateType;
+
+  StateArrayWriter (SpaceHandle<SpaceType> spSpace, const std::string& path)
+    : _spSpace{std::move(spSpace)}
+    , _file{path, MappedFile::Mode::Create}
+  {
+    _spSpace->appendSchema(_schema);
+    _stateSize  = _spSpace->getSerializationSize();
+    _dataOffset = StateArrayFormat::getDataOffset(_schema);
+    _file.resize(_dataOffset + kInitialCapacity*_stateSize);
+    StateArrayFormat::writeHeader(_file, _schema, _stateSize, 0);
+  }
+
+  StateArrayWriter (const SpaceType& space, const std::string& path)
+    : StateArrayWriter{makeSpaceHandle(space), path}
+  { }
+
+  StateArrayWriter (const StateArrayWriter& orig)            = delete;
+  StateArrayWriter (StateArrayWriter&& sink)                 = default;
+  StateArrayWriter& operator= (const StateArrayWriter& orig) = delete;
+  StateArrayWriter& operator= (StateArrayWriter&& sink)      = delete;
+
+  ~StateArrayWriter ()
+  {
+    try {
+      close();
+    }
+    catch (...) {
+    }
+  }
+
+  std::size_t size () const
+  { return _numStates; }
+
+  void append (const StateType& state)
+  {
+    reserve(_numStates + 1);
+    _spSpace->serialize(state, recordData(_numStates));
+    ++_numStates;
+  }
+
+  void appendMany (const StateType* states, std::size_t numStates)
+  {
+    reserve(_numStates + numStates);
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      _spSpace->serialize(states[idx], recordData(_numStates + idx));
+    }
+    _numStates += numStates;
+  }
+
+  void close ()
+  {
+    if (!_file.isOpen()) {
+      return;
+    }
+    _file.resize(_dataOffset + _numStates*_stateSize);
+    StateArrayFormat::setNumStates(_file, _numStates);
+    _file.sync();
+    _file.close();
+  }
+
+private:
+  static constexpr std::size_t kInitialCapacity = 1024;
+
+  unsigned char* recordData (std::size_t idx)
+  { return _file.data() + _dataOffset + idx*_stateSize; }
+
+  void reserve (std::size_t numStates)
+  {
+    if (!_file.isOpen()) {
+      throw std::logic_error{"state array " + _file.getPath() + " is closed"};
+    }
+    std::size_t capacity = _stateSize > 0 ? (_file.size() - _dataOffset)/_stateSize : numStates;
+    if (numStates <= capacity) {
+      return;
+    }
+    while (capacity < numStates) {
+      capacity *= 2;
+    }
+    _file.resize(_dataOffset + capacity*_stateSize);
+  }
+
+  SpaceHandle<SpaceType> _spSpace;
+  MappedFile             _file;
+  std::string            _schema;
+  std::size_t            _stateSize  = 0;
+  std::size_t            _dataOffset = 0;
+  std::size_t            _numStates  = 0;
+};
+
+//
+// Read access to a file written by StateArrayWriter.  The space must
+// have the schema the file was written with.  record gives the raw
+// bytes of a state in place; read deserializes one.
+//
+template <OmplSerializableSpace SpaceType>
+class StateArrayReader
+{
+public:
+  typedef typename SpaceType::StateType StateType;
+
+  StateArrayReader (SpaceHandle<SpaceType> spSpace, const std::string& path)
+    : _spSpace{std::move(spSpace)}
+    , _file{path, MappedFile::Mode::ReadOnly}
+  {
+    std::string schema;
+    _spSpace->appendSchema(schema);
+    const auto header = StateArrayFormat::readHeader(_file, schema, _spSpace->getSerializationSize());
+    _stateSize  = header.stateSize;
+    _dataOffset = header.dataOffset;
+    _numStates  = header.numStates;
+  }
+
+  StateArrayReader (const SpaceType& space, const std::string& path)
+    : StateArrayReader{makeSpaceHandle(space), path}
+  { }
+
+  StateArrayReader (const StateArrayReader& orig)            = delete;
+  StateArrayReader (StateArrayReader&& sink)                 = default;
+  StateArrayReader& operator= (const StateArrayReader& orig) = delete;
+  StateArrayReader& operator= (StateArrayReader&& sink)      = default;
+  ~StateArrayReader ()                                       = default;
+
+  std::size_t size () const
+  { return _numStates; }
+
+  std::size_t getStateSize () const
+  { return _stateSize; }
+
+  // The serialized bytes of state idx, which must be less than size().
+  const unsigned char* record (std::size_t idx) const
+  { return _file.data() + _dataOffset + idx*_stateSize; }
+
+  //
+  // outState must have been made by the space (for a compound space,
+  // it needs the space's layout).  Throws std::out_of_range if idx is
+  // not less than size().
+  //
+  void read (std::size_t idx, StateType& outState) const
+  {
+    if (idx >= _numStates) {
+      throw std::out_of_range{"state index out of range"};
+    }
+    _spSpace->deserialize(record(idx), outState);
+  }
+
+  StateType read (std::size_t idx) const
+  {
+    StateType outState{_spSpace->makeState()};
+    read(idx, outState);
+    return outState;
+  }
+
+  // Read states [begin, begin+numStates) into outStates.
+  void readMany (std::size_t begin, std::size_t numStates, StateType* outStates) const
+  {
+    if (begin > _numStates || numStates > _numStates - begin) {
+      throw std::out_of_range{"state range out of range"};
+    }
+    for (std::size_t idx = 0; idx < numStates; ++idx) {
+      _spSpace->deserialize(record(begin + idx), outStates[idx]);
+    }
+  }
+
+private:
+  SpaceHandle<SpaceType> _spSpace;
+  MappedFile             _file;
+  std::size_t            _stateSize  = 0;
+  std::size_t            _dataOffset = 0;
+  std::size_t            _numStates  = 0;
+};
+
+#endif // __STATE_ARRAY_FILE_H__
@@ -0,0 +1,300 @@
+#ifndef __STATIC_COMPOUND_STATE_SPACE_H__
+#define __STATIC_COMPOUND_STATE_SPACE_H__
+
+#include "CompoundStateSpace.h"   // for the generic draw fallback
+#include "OmplConcepts.h"
+#include "RandomNumberGenerator.h"
+
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <utility>
+
+//
+// A compound space whose subspaces are fixed at compile time.
+//
+// Compound::Space type-erases its subspaces: substates sit at layout
+// offsets in one buffer and every operation makes a virtual call per
+// subspace on an untyped substate pointer.  Here the state is a
+// std::tuple of substates and each operation is a fold expression over
+// the subspace indices, so calls into SO2, RealVector etc. are direct
+// and can be inlined.  Use it whenever the composition is known when
+// the program is built.
+//
+
+namespace spaces
+{
+  namespace StaticCompound
+  {
+    //////////
+    //
+    // STATE
+    //
+    //////////
+
+    template <OmplState... Substates>
+    class State : public std::tuple<Substates...>
+    {
+    public:
+      typedef State StateType;
+
+      using std::tuple<Substates...>::tuple;
+
+      State ()                             = default;
+      State (const State& orig)            = default;
+      State (State&& sink)                 = default;
+      State& operator= (const State& orig) = default;
+      State& operator= (State&& sink)      = default;
+      ~State ()                            = default;
+
+      template <std::size_t Idx>
+      auto& getSubstate ()
+      { return std::get<Idx>(*this); }
+
+      template <std::size_t Idx>
+      const auto& getSubstate () const
+      { return std::get<Idx>(*this); }
+
+      friend void draw (const State& state, std::ostream& ostr, std::size_t indent)
+      {
+        ostr << std::string(indent, ' ') << "begin static compound state" << std::endl;
+        std::apply([&](const Substates&... substates) { (draw(substates, ostr, indent + 2), ...); },
+                   static_cast<const std::tuple<Substates...>&>(state));
+        ostr << std::string(indent, ' ') << "end static compound state" << std::endl;
+      }
+    };
+
+    //////////
+    //
+    // SPACE
+    //
+    //////////
+
+    template <OmplSpace... Spaces>
+    class Space
+    {
+      static_assert(sizeof...(Spaces) > 0, "a static compound space needs at least one subspace");
+
+    public:
+      typedef State<typename Spaces::StateType...> StateType;
+
+      static constexpr std::size_t kNumSubspaces = sizeof...(Spaces);
+
+      //
+      // All subspace weights start at 1.  As with Compound::Space,
+      // subspaces are always sampled from the compound space's stream
+      // (or the one passed to a sampling call), never their own.
+      //
+      Space ()
+      { _weights.fill(1.0); }
+      explicit Space (const Spaces&... spaces)
+        : _spaces{spaces...}
+      { _weights.fill(1.0); }
+      Space (const RandomNumberGenerator& rng, const Spaces&... spaces)
+        : _spaces{spaces...}
+        , _rng{rng}
+      { _weights.fill(1.0); }
+      Space (const Space& orig)           = default;
+      Space& operator=(const Space& orig) = default;
+      ~Space ()                           = default;
+
+      template <std::size_t Idx>
+      auto& getSubspace ()
+      { return std::get<Idx>(_spaces); }
+
+      template <std::size_t Idx>
+      const auto& getSubspace () const
+      { return std::get<Idx>(_spaces); }
+
+      //
+      // Weights scale each subspace's contribution to distance and
+      // getMaximumExtent.  They should be non-negative.
+      //
+      void setSubspaceWeight (std::size_t idx, double weight)
+      { _weights[idx] = weight; }
+
+      double getSubspaceWeight (std::size_t idx) const
+      { return _weights[idx]; }
+
+      StateType makeState () const
+      { return makeState(Indices{}); }
+
+      StateType sampleUniform () const
+      {
+        StateType outState{makeState()};
+        sampleUniform(outState);
+        return outState;
+      }
+
+      void sampleUniform (StateType& outState) const
+      { sampleUniform(outState, _rng); }
+
+      void sampleUniform (StateType& outState, RandomNumberGenerator& rng) const
+      {
+        forEachSubspace([&](auto idx) {
+          std::get<idx>(_spaces).sampleUniform(std::get<idx>(outState), rng);
+        });
+      }
+
+      StateType sampleUniformNear (const StateType& state, double distance) const
+      {
+        StateType outState{makeState()};
+        sampleUniformNear(state, distance, outState);
+        return outState;
+      }
+
+      void sampleUniformNear (const StateType& state, double distance, StateType& outState) const
+      { sampleUniformNear(state, distance, outState, _rng); }
+
+      void sampleUniformNear (const StateType& state, double distance, StateType& outState, RandomNumberGenerator& rng) const
+      {
+        forEachSubspace([&](auto idx) {
+          std::get<idx>(_spaces).sampleUniformNear(std::get<idx>(state), distance, std::get<idx>(outState), rng);
+        });
+      }
+
+      StateType sampleGaussianNear (const StateType& state, double stddev) const
+      {
+        StateType outState{makeState()};
+        sampleGaussianNear(state, stddev, outState);
+        return outState;
+      }
+
+      void sampleGaussianNear (const StateType& state, double stddev, StateType& outState) const
+      { sampleGaussianNear(state, stddev, outState, _rng); }
+
+      void sampleGaussianNear (const StateType& state, double stddev, StateType& outState, RandomNumberGenerator& rng) const
+      {
+        forEachSubspace([&](auto idx) {
+          std::get<idx>(_spaces).sampleGaussianNear(std::get<idx>(state), stddev, std::get<idx>(outState), rng);
+        });
+      }
+
+      //
+      // Each subspace consumes the next getDimension() coordinates,
+      // in subspace order.
+      //
+      void sampleFromUnitCube (const double* unitCoords, StateType& outState) const
+      {
+        forEachSubspace([&](auto idx) {
+          std::get<idx>(_spaces).sampleFromUnitCube(unitCoords, std::get<idx>(outState));
+          unitCoords += std::get<idx>(_spaces).getDimension();
+        });
+      }
+
+      //
+      // Weighted sum of the subspace distances.
+      //
+      double distance (const StateType& fromState, const StateType& toState) const
+      {
+        return sumOverSubspaces([&](auto idx) {
+          return _weights[idx]*std::get<idx>(_spaces).distance(std::get<idx>(fromState), std::get<idx>(toState));
+        });
+      }
+
+      void distanceMany (const StateType& fromState, const StateType* toStates, std::size_t numStates, double* outDistances) const
+      {
+        for (std::size_t idx = 0; idx < numStates; ++idx) {
+          outDistances[idx] = distance(fromState, toStates[idx]);
+        }
+      }
+
+      StateType interpolate (const StateType& state1, const StateType& state2, double tt) const
+      {
+        StateType outState{makeState()};
+        interpolate(state1, state2, tt, outState);
+        return outState;
+      }
+
+      void interpolate (const StateType& state1, const StateType& state2, double tt, StateType& outState) const
+      {
+        forEachSubspace([&](auto idx) {
+          std::get<idx>(_spaces).interpolate(std::get<idx>(state1), std::get<idx>(state2), tt, std::get<idx>(outState));
+        });
+      }
+
+      bool satisfiesBounds (const StateType& state) const
+      { return satisfiesBounds(state, Indices{}); }
+
+      void enforceBounds (StateType& state) const
+      {
+        forEachSubspace([&](auto idx) {
+          std::get<idx>(_spaces).enforceBounds(std::get<idx>(state));
+        });
+      }
+
+      unsigned int getDimension () const
+      {
+        return sumOverSubspaces([&](auto idx) {
+          return std::get<idx>(_spaces).getDimension();
+        });
+      }
+
+      double getMaximumExtent () const
+      {
+        return sumOverSubspaces([&](auto idx) {
+          return _weights[idx]*std::get<idx>(_spaces).getMaximumExtent();
+        });
+      }
+
+      //
+      // Product of the subspace measures, skipping zero-dimensional
+      // subspaces.
+      //
+      double getMeasure () const
+      { return getMeasure(Indices{}); }
+
+      friend void draw (const Space& space, std::ostream& ostr, std::size_t indent)
+      {
+        ostr << std::string(indent, ' ') << "begin static compound space" << std::endl;
+        std::apply([&](const Spaces&... spaces) { (draw(spaces, ostr, indent + 2), ...); }, space._spaces);
+        ostr << std::string(indent, ' ') << "end static compound space" << std::endl;
+      }
+
+    private:
+      typedef std::index_sequence_for<Spaces...> Indices;
+
+      //
+      // Call function once per subspace, in order, with the subspace
+      // index as a std::integral_constant so it can index the tuples.
+      //
+      template <typename Function>
+      void forEachSubspace (Function&& function) const
+      { forEachSubspace(function, Indices{}); }
+
+      template <typename Function, std::size_t... Idx>
+      static void forEachSubspace (Function& function, std::index_sequence<Idx...>)
+      { (function(std::integral_constant<std::size_t, Idx>{}), ...); }
+
+      template <typename Function>
+      auto sumOverSubspaces (Function&& function) const
+      { return sumOverSubspaces(function, Indices{}); }
+
+      template <typename Function, std::size_t... Idx>
+      static auto sumOverSubspaces (Function& function, std::index_sequence<Idx...>)
+      { return (function(std::integral_constant<std::size_t, Idx>{}) + ...); }
+
+      template <std::size_t... Idx>
+      StateType makeState (std::index_sequence<Idx...>) const
+      { return StateType{std::get<Idx>(_spaces).makeState()...}; }
+
+      template <std::size_t... Idx>
+      bool satisfiesBounds (const StateType& state, std::index_sequence<Idx...>) const
+      { return (std::get<Idx>(_spaces).satisfiesBounds(std::get<Idx>(state)) && ...); }
+
+      template <std::size_t... Idx>
+      double getMeasure (std::index_sequence<Idx...>) const
+      {
+        return ((std::get<Idx>(_spaces).getDimension() > 0 ? std::get<Idx>(_spaces).getMeasure() : 1.0) * ...);
+      }
+
+      std::tuple<Spaces...>                _spaces;
+      std::array<double, sizeof...(Spaces)> _weights;
+      mutable RandomNumberGenerator        _rng;
+    };
+  }
+}
+
+#endif // __STATIC_COMPOUND_STATE_SPACE_H__
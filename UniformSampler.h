@@ -0,0 +1,61 @@
+#ifndef __UNIFORM_SAMPLER_H__
+#define __UNIFORM_SAMPLER_H__
+
+#include "RandomNumberGenerator.h"
+#include "SpaceHandle.h"
+
+#include <utility>
+
+namespace Samplers
+{
+  //
+  // SpaceType::sampleUniform behind the sampler interface, so that
+  // code written against samplers (e.g. SampleProducerPool) can draw
+  // plain uniform samples too.
+  //
+  template<typename SpaceType>
+  class UniformSampler
+  {
+  public:
+    explicit UniformSampler (SpaceHandle<SpaceType> spSpace)
+      : _spSpace(std::move(spSpace))
+    { }
+
+    UniformSampler (SpaceHandle<SpaceType> spSpace, const RandomNumberGenerator& rng)
+      : _spSpace(std::move(spSpace))
+      , _rng(rng)
+    { }
+
+    explicit UniformSampler (SpaceType space)
+      : UniformSampler(makeSpaceHandle(std::move(space)))
+    { }
+
+    UniformSampler (SpaceType space, const RandomNumberGenerator& rng)
+      : UniformSampler(makeSpaceHandle(std::move(space)), rng)
+    { }
+
+    UniformSampler (const UniformSampler<SpaceType>& orig)            = default;
+    UniformSampler (UniformSampler<SpaceType>&& sink)                 = default;
+    UniformSampler& operator= (const UniformSampler<SpaceType>& orig) = default;
+    UniformSampler& operator= (UniformSampler<SpaceType>&& sink)      = default;
+    ~UniformSampler ()                                                = default;
+
+    const SpaceHandle<SpaceType>& getSpace () const
+    { return _spSpace; }
+
+    bool sample (typename SpaceType::StateType& outState) const
+    { return sample(outState, _rng); }
+
+    bool sample (typename SpaceType::StateType& outState, RandomNumberGenerator& rng) const
+    {
+      _spSpace->sampleUniform(outState, rng);
+      return true;
+    }
+
+  private:
+    SpaceHandle<SpaceType>        _spSpace;
+    mutable RandomNumberGenerator _rng;
+  };
+}
+
+#endif // __UNIFORM_SAMPLER_H__
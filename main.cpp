@@ -1,15 +1,37 @@
 #include "So2StateSpace.h"
+#include "So2FixedPointStateSpace.h"
+#include "So3StateSpace.h"
 #include "GaussianSampler.h"
 // #include "RandomNumberGenerator.h"
-// #include "RandomStateValidityChecker.h"
+#include "RandomStateValidityChecker.h"
+#include "CachedStateValidityChecker.h"
 // #include "SimpleDiscreteMotionValidator.h"
 // #include "OmplConcepts.h"
 #include "CompoundStateSpace.h"
+#include "StaticCompoundStateSpace.h"
+#include "RealVectorStateSpace.h"
+#include "SampleProducerPool.h"
+#include "BridgeTestSampler.h"
+#include "ObstacleBasedSampler.h"
+#include "UniformSampler.h"
+#include "StateArrayFile.h"
+#include "QuasiRandomSampler.h"
 
 #include "ompl/datastructures/NearestNeighborsGNATNoThreadSafety.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 using namespace std;
 
 template <>
@@ -20,6 +42,850 @@ template <>
 void draw (const SO2::State& obj, ostream& ostr, size_t indent)
 { ostr << string(indent, ' ') << "SO2::State (" << obj.theta_rad << ")" << endl; }
 
+//
+// Compare the ziggurat's tail probabilities P(|z| > t) with the exact
+// ones, for the scalar and the batch normal generators.  The z-scores
+// should all be small (|z| < 4 or so).
+//
+static void checkNormalTails ()
+{
+  const double thresholds[] = { 1.0, 2.0, 3.7 };
+  const size_t numDraws     = 20'000'000;
+  const size_t blockSize    = 4096;
+
+  for (bool batch : { false, true }) {
+    RandomNumberGenerator rng{1};
+    size_t         counts[3] = { 0, 0, 0 };
+    vector<double> block(blockSize);
+    for (size_t drawn = 0; drawn < numDraws; drawn += blockSize) {
+      if (batch) {
+        rng.realNormal_0_1(block.data(), blockSize);
+      }
+      else {
+        for (auto& zz : block) {
+          zz = rng.realNormal_0_1();
+        }
+      }
+      for (double zz : block) {
+        for (int idx = 0; idx < 3; ++idx) {
+          counts[idx] += fabs(zz) > thresholds[idx];
+        }
+      }
+    }
+
+    cout << (batch ? "batch: " : "scalar:");
+    for (int idx = 0; idx < 3; ++idx) {
+      const double expected = erfc(thresholds[idx]/sqrt(2.0));
+      const double observed = double(counts[idx])/numDraws;
+      const double zScore   = (observed - expected)/sqrt(expected*(1.0 - expected)/numDraws);
+      cout << "  P(|z|>" << thresholds[idx] << ") = " << observed
+           << " (exact " << expected << ", z = " << zScore << ")";
+    }
+    cout << endl;
+  }
+}
+
+//
+// Workers whose sampler can never succeed must still stop: with every
+// state valid, no Gaussian pair has exactly one valid end, so the
+// validating sampler never returns a sample.  The pool should be
+// destroyed (and its workers joined) within a few milliseconds of the
+// sleep.
+//
+static void checkPoolShutdown ()
+{
+  typedef RandomStateValidityChecker<SO2::Space>      Checker;
+  typedef Samplers::ValidatingGaussianSampler<Checker> Sampler;
+
+  const auto start = chrono::steady_clock::now();
+  {
+    Samplers::SampleProducerPool<Sampler> pool(Sampler{Checker{1.0}, SO2::Space{}, 0.1}, 2, 16);
+    this_thread::sleep_for(chrono::milliseconds(50));
+
+    SO2::State state;
+    cout << "popped: " << pool.tryPop(state) << ", gave up " << pool.getNumRejected() << " times" << endl;
+  }
+  const auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+  cout << "pool stopped after " << elapsed.count() << " ms" << endl;
+}
+
+//
+// Accepts every state, and notes the first draw of each stream it is
+// given, so that the streams the pool gives its workers' validators
+// can be told apart.
+//
+class StreamNotingChecker
+{
+public:
+  typedef SO2::Space SpaceType;
+  typedef SO2::State StateType;
+
+  StreamNotingChecker ()
+    : _spMutex{make_shared<mutex>()}
+    , _spFirstDraws{make_shared<vector<uint64_t>>()}
+  { }
+
+  bool isValid (const StateType&) const
+  { return true; }
+
+  void setRandomNumberGenerator (const RandomNumberGenerator& rng)
+  {
+    RandomNumberGenerator stream{rng};
+    lock_guard<mutex> lock(*_spMutex);
+    _spFirstDraws->push_back(stream.uintBelow(UINT64_MAX));
+  }
+
+  size_t getNumStreams () const
+  {
+    lock_guard<mutex> lock(*_spMutex);
+    return _spFirstDraws->size();
+  }
+
+  size_t getNumDistinctStreams () const
+  {
+    lock_guard<mutex> lock(*_spMutex);
+    return set<uint64_t>(_spFirstDraws->begin(), _spFirstDraws->end()).size();
+  }
+
+private:
+  shared_ptr<mutex>            _spMutex;
+  shared_ptr<vector<uint64_t>> _spFirstDraws;
+};
+
+//
+// Each of the pool's workers should give its validator, or its
+// validating sampler's validator, a stream of its own, and a pool
+// without workers should be refused.
+//
+static void checkPoolValidatorStreams ()
+{
+  const unsigned int numWorkers = 4;
+
+  StreamNotingChecker uniformChecker;
+  {
+    Samplers::SampleProducerPool<Samplers::UniformSampler<SO2::Space>, StreamNotingChecker>
+      pool(Samplers::UniformSampler<SO2::Space>{SO2::Space{}}, uniformChecker, numWorkers, 16);
+    SO2::State state;
+    pool.pop(state);
+  }
+  cout << "uniform sampler: " << uniformChecker.getNumDistinctStreams() << " distinct of "
+       << uniformChecker.getNumStreams() << " validator streams" << endl;
+
+  typedef Samplers::ValidatingGaussianSampler<StreamNotingChecker> Sampler;
+  StreamNotingChecker gaussianChecker;
+  {
+    // No pair has exactly one valid end, so nothing is ever queued;
+    // the workers set up their validators before they start sampling.
+    Samplers::SampleProducerPool<Sampler> pool(Sampler{gaussianChecker, SO2::Space{}, 0.1}, numWorkers, 16);
+  }
+  cout << "validating sampler: " << gaussianChecker.getNumDistinctStreams() << " distinct of "
+       << gaussianChecker.getNumStreams() << " validator streams" << endl;
+
+  try {
+    Samplers::SampleProducerPool<Sampler> pool(Sampler{gaussianChecker, SO2::Space{}, 0.1}, 0, 16);
+    cout << "a pool without workers was accepted" << endl;
+  }
+  catch (const invalid_argument& error) {
+    cout << "no workers: " << error.what() << endl;
+  }
+}
+
+//
+// The unit square with a disc of radius 0.3 at its center blocked.
+//
+struct DiscObstacleChecker
+{
+  typedef RealVector::Space<2> SpaceType;
+  typedef RealVector::State<2> StateType;
+
+  bool isValid (const StateType& state) const
+  {
+    const double xx = state.values[0] - 0.5;
+    const double yy = state.values[1] - 0.5;
+    return xx*xx + yy*yy > 0.3*0.3;
+  }
+};
+
+//
+// Adapt the Gaussian sampler's stddev towards 10% acceptance around
+// the disc, starting far too small and far too large.  Both runs
+// should settle at about the same stddev (around 0.065): from 0.5
+// within some 15k pairs, and from 1e-4, which has almost no pairs
+// accepted at first, within some 40k.
+//
+static void checkStddevAdaptation ()
+{
+  typedef Samplers::ValidatingGaussianSampler<DiscObstacleChecker> Sampler;
+
+  for (double initialStddev : { 1e-4, 0.5 }) {
+    Sampler sampler{DiscObstacleChecker{}, RealVector::Space<2>{}, initialStddev, RandomNumberGenerator{7}};
+    sampler.enableAdaptation(0.1, 1e-5, 1.0, 2048);
+
+    cout << "initial stddev " << initialStddev << ":";
+    RealVector::State<2> state;
+    for (size_t checkpoint = 10000; checkpoint <= 60000; checkpoint += 10000) {
+      while (sampler.getStatistics().totalPairs < checkpoint) {
+        sampler.sample(state);
+      }
+      const auto statistics = sampler.getStatistics();
+      cout << "  " << statistics.totalPairs << " pairs: " << statistics.stddev
+           << " (" << statistics.acceptanceRate << ")";
+    }
+    cout << endl;
+  }
+}
+
+//
+// The disc obstacle again, with each check taking about a microsecond
+// of busy time, as an expensive collision check would.
+//
+struct SlowDiscObstacleChecker : DiscObstacleChecker
+{
+  bool isValid (const StateType& state) const
+  {
+    const auto until = chrono::steady_clock::now() + chrono::microseconds(1);
+    while (chrono::steady_clock::now() < until) {
+    }
+    return DiscObstacleChecker::isValid(state);
+  }
+};
+
+//
+// With a budget of 8 microseconds of checking per sample and checks
+// of about a microsecond, a sample may take no more than about 8
+// checks, so the target should rise from 0.1 to about 0.25 and the
+// acceptance rate follow it.
+//
+static void checkStddevCostBudget ()
+{
+  typedef Samplers::ValidatingGaussianSampler<SlowDiscObstacleChecker> Sampler;
+
+  Sampler sampler{SlowDiscObstacleChecker{}, RealVector::Space<2>{}, 0.05, RandomNumberGenerator{7}};
+  sampler.enableAdaptation(0.1, 1e-5, 1.0, 2048);
+  sampler.setMaxCheckSecondsPerSample(8e-6);
+
+  RealVector::State<2> state;
+  while (sampler.getStatistics().totalPairs < 30000) {
+    sampler.sample(state);
+  }
+  const auto statistics = sampler.getStatistics();
+  cout << "seconds per check " << statistics.secondsPerCheck << ", target " << statistics.targetAcceptance
+       << ", acceptance " << statistics.acceptanceRate << ", checks per sample " << statistics.checksPerSample
+       << ", stddev " << statistics.stddev << endl;
+}
+
+//
+// The unit square with a wall across it at 0.3 <= x <= 0.7, pierced
+// by a narrow passage at |y - 0.5| < 0.02.
+//
+struct NarrowPassageChecker
+{
+  typedef RealVector::Space<2> SpaceType;
+  typedef RealVector::State<2> StateType;
+
+  bool isValid (const StateType& state) const
+  { return isOutsideWall(state.values[0]) || isInPassage(state.values[1]); }
+
+  // The distance from a valid state to the wall, which is two
+  // rectangles, one either side of the passage.
+  static double distanceToWall (const StateType& state)
+  {
+    const double dx = max({0.3 - state.values[0], 0.0, state.values[0] - 0.7});
+    const double dyBelow = max(state.values[1] - 0.48, 0.0);
+    const double dyAbove = max(0.52 - state.values[1], 0.0);
+    return min(hypot(dx, dyBelow), hypot(dx, dyAbove));
+  }
+
+  static bool isOutsideWall (double xx)
+  { return xx < 0.3 || xx > 0.7; }
+
+  static bool isInPassage (double yy)
+  { return fabs(yy - 0.5) < 0.02; }
+};
+
+// The same, checking states in batches (see BatchValidity.h).
+struct BatchNarrowPassageChecker : NarrowPassageChecker
+{
+  size_t isValidMany (const StateType* states, size_t numStates, uint64_t* outValidMask, bool stopAtFirstInvalid) const
+  { return ::isValidMany(NarrowPassageChecker{}, states, numStates, outValidMask, stopAtFirstInvalid); }
+};
+
+//
+// Bridge-test samples should all lie in the passage: both ends of a
+// bridge are in the wall, so a valid midpoint can only be there.
+// Obstacle-based samples should lie within the resolution of the
+// wall.
+//
+template <typename CheckerType>
+static void checkNarrowPassageSamplers (const char* name)
+{
+  const size_t numSamples = 1000;
+  RealVector::State<2> state;
+
+  Samplers::BridgeTestSampler<CheckerType> bridgeSampler{CheckerType{}, RealVector::Space<2>{}, 0.05, RandomNumberGenerator{11}};
+  size_t numInPassage = 0;
+  for (size_t idx = 0; idx < numSamples; ++idx) {
+    bridgeSampler.sample(state);
+    numInPassage += !NarrowPassageChecker::isOutsideWall(state.values[0]) && NarrowPassageChecker::isInPassage(state.values[1]);
+  }
+  cout << name << " bridge test: " << numInPassage << " of " << numSamples << " samples in the passage" << endl;
+
+  const double resolution = 1e-3;
+  Samplers::ObstacleBasedSampler<CheckerType> obstacleSampler{CheckerType{}, RealVector::Space<2>{}, resolution,
+                                                              RandomNumberGenerator{11}};
+  size_t numNearWall = 0;
+  size_t numValid    = 0;
+  for (size_t idx = 0; idx < numSamples; ++idx) {
+    obstacleSampler.sample(state);
+    numValid    += NarrowPassageChecker{}.isValid(state);
+    numNearWall += NarrowPassageChecker::distanceToWall(state) <= resolution;
+  }
+  cout << name << " obstacle based: " << numValid << " of " << numSamples << " samples valid, "
+       << numNearWall << " within " << resolution << " of the wall" << endl;
+}
+
+//
+// A substate whose copies start throwing once a countdown runs out,
+// as an allocating substate's would when memory runs out.
+//
+struct CountdownSubstate
+{
+  typedef CountdownSubstate StateType;
+
+  static int numCopiesLeft;
+
+  CountdownSubstate () = default;
+
+  CountdownSubstate (const CountdownSubstate& orig)
+    : values{orig.values}
+  {
+    if (numCopiesLeft-- == 0) {
+      throw runtime_error{"CountdownSubstate: out of copies"};
+    }
+  }
+
+  CountdownSubstate& operator= (const CountdownSubstate& orig) = default;
+
+  bool operator== (const CountdownSubstate& other) const
+  { return values == other.values; }
+
+  bool operator!= (const CountdownSubstate& other) const
+  { return values != other.values; }
+
+  vector<double> values = vector<double>(4);
+};
+
+int CountdownSubstate::numCopiesLeft = -1;
+
+void draw (const CountdownSubstate&, ostream& ostr, size_t indent)
+{ ostr << string(indent, ' ') << "CountdownSubstate" << endl; }
+
+//
+// Copying a compound state, appending one's substates to another and
+// allocating from an arena should each throw when a substate copy
+// does, without leaking (run under a leak checker) or destroying
+// substates that were never made.
+//
+static void checkStateCopyFailure ()
+{
+  spaces::Compound::State state;
+  state.addSubstate(RealVector::DynamicState(3));
+  state.addSubstate(CountdownSubstate{});
+  state.addSubstate(RealVector::DynamicState(5));
+  state.addSubstate(CountdownSubstate{});
+
+  size_t numThrown = 0;
+  for (int numCopies = 0; numCopies < 3; ++numCopies) {
+    CountdownSubstate::numCopiesLeft = numCopies;
+    try {
+      spaces::Compound::State copy{state};
+    }
+    catch (const runtime_error&) {
+      ++numThrown;
+    }
+
+    CountdownSubstate::numCopiesLeft = numCopies;
+    try {
+      spaces::Compound::State extended;
+      extended.addSubstates(state);
+    }
+    catch (const runtime_error&) {
+      ++numThrown;
+    }
+  }
+
+  CountdownSubstate::numCopiesLeft = -1;
+  spaces::Compound::Arena arena{state};
+  CountdownSubstate::numCopiesLeft = 1;
+  try {
+    arena.allocState();
+  }
+  catch (const runtime_error&) {
+    ++numThrown;
+  }
+  CountdownSubstate::numCopiesLeft = -1;
+  arena.freeState(arena.allocState());
+
+  cout << "threw " << numThrown << " of 5 times" << endl;
+}
+
+//
+// Compares SO2::FixedPointSpace with SO2::Space over random pairs of
+// angles that both represent exactly: distances should agree to
+// rounding, and interpolated angles to within one quantization step.
+// Interpolation between antipodal angles is left out, since either
+// way around is a shortest path and the two spaces pick differently.
+//
+template <typename FixedPointSpaceType>
+static void checkFixedPointSo2 (const char* name)
+{
+  typedef typename FixedPointSpaceType::State FixedPointState;
+
+  const SO2::Space          space;
+  const FixedPointSpaceType fixedPointSpace;
+  RandomNumberGenerator     rng{5};
+
+  const uint64_t halfTurn = uint64_t{1} << (FixedPointState::kNumBits - 1);
+
+  double maxDistanceError    = 0.0;
+  double maxInterpolateError = 0.0;
+  size_t numAntipodal        = 0;
+  for (int pair = 0; pair < 100000; ++pair) {
+    const FixedPointState fixedFrom = FixedPointState::fromRadians(rng.realUniform_negPi_pi());
+    const FixedPointState fixedTo   = FixedPointState::fromRadians(rng.realUniform_negPi_pi());
+    const SO2::State      from{fixedFrom.toRadians()};
+    const SO2::State      to{fixedTo.toRadians()};
+
+    const double distanceError = fabs(fixedPointSpace.distance(fixedFrom, fixedTo) - space.distance(from, to));
+    maxDistanceError = max(maxDistanceError, distanceError);
+
+    const double tt = rng.realUniform_0_1();
+    if (static_cast<decltype(fixedFrom.turns)>(fixedTo.turns - fixedFrom.turns) == halfTurn) {
+      ++numAntipodal;
+      continue;
+    }
+    FixedPointState fixedBetween;
+    SO2::State      between;
+    fixedPointSpace.interpolate(fixedFrom, fixedTo, tt, fixedBetween);
+    space.interpolate(from, to, tt, between);
+    const double interpolateError = space.distance(SO2::State{fixedBetween.toRadians()}, between);
+    maxInterpolateError = max(maxInterpolateError, interpolateError/FixedPointState::kRadiansPerUnit);
+  }
+  cout << name << ": max distance error " << maxDistanceError
+       << ", max interpolation error " << maxInterpolateError << " steps ("
+       << numAntipodal << " antipodal pairs left out)" << endl;
+}
+
+//
+// Quasi-random against uniform samples of a compound SO2 x [-1, 2]
+// space, binned on a 16x16 grid.  Every sample should map into the
+// bounds, and the Halton points should fill each cell with close to
+// the expected 16 samples (12 to 20 with this seed) where the uniform
+// ones spread more than twice as widely.
+//
+template <typename SamplerType>
+static void binCompoundSamples (const SamplerType& sampler, const char* name)
+{
+  const size_t kCells = 16;
+  const size_t kNumSamples = 16*kCells*kCells;
+
+  vector<size_t> counts(kCells*kCells, 0);
+  size_t numOutOfBounds = 0;
+  auto state = sampler.getSpace()->makeState();
+  for (size_t idx = 0; idx < kNumSamples; ++idx) {
+    sampler.sample(state);
+    const double theta = state.template getSubstate<SO2::State>(0).theta_rad;
+    const double value = state.template getSubstate<RealVector::State<1>>(1).values[0];
+    if (theta < -M_PI || theta >= M_PI || value < -1.0 || value > 2.0) {
+      ++numOutOfBounds;
+      continue;
+    }
+    const size_t row = min(kCells - 1, size_t((theta + M_PI)/(2*M_PI)*kCells));
+    const size_t col = min(kCells - 1, size_t((value + 1.0)/3.0*kCells));
+    ++counts[row*kCells + col];
+  }
+
+  const auto extremes = minmax_element(counts.begin(), counts.end());
+  cout << name << " " << numOutOfBounds << " out of bounds, cell counts "
+       << *extremes.first << " to " << *extremes.second << endl;
+}
+
+static void checkQuasiRandomSampler ()
+{
+  spaces::Compound::Space compSpace;
+  compSpace.addSubspace(SO2::Space{});
+  compSpace.addSubspace(RealVector::Space<1>{-1.0, 2.0});
+
+  binCompoundSamples(Samplers::QuasiRandomSampler<spaces::Compound::Space>{compSpace, RandomNumberGenerator{5}}, "quasi-random:");
+  binCompoundSamples(Samplers::UniformSampler<spaces::Compound::Space>{compSpace, RandomNumberGenerator{5}}, "uniform:     ");
+}
+
+//
+// SO3 rotations: uniform samples should be unit quaternions, the
+// lower bound should never exceed the geodesic distance, the batch
+// kernels should agree with the scalar ones, and slerp should hit its
+// endpoints and split the distance evenly at tt = 0.5.  Distances
+// between nearly equal rotations go through acos near 1, which
+// resolves no better than about 3e-8.
+//
+static void checkSo3Space ()
+{
+  const size_t kNumStates = 10000;
+
+  SO3::Space space{RandomNumberGenerator{3}};
+  SO3::StateBatch batch;
+  space.sampleUniform(kNumStates, batch);
+
+  const SO3::State from = space.sampleUniform();
+  vector<double> distances(kNumStates);
+  vector<double> lowerBounds(kNumStates);
+  space.distanceMany(from, batch, distances.data());
+  space.distanceLowerBoundMany(from, batch, lowerBounds.data());
+
+  SO3::StateBatch fromBatch{kNumStates};
+  for (size_t idx = 0; idx < kNumStates; ++idx) {
+    fromBatch.set(idx, from);
+  }
+  SO3::StateBatch midBatch;
+  space.interpolate(fromBatch, batch, 0.5, midBatch);
+
+  double maxNormError = 0.0;
+  double maxBatchError = 0.0;
+  double maxEndpointError = 0.0;
+  double maxMidpointError = 0.0;
+  size_t numAboveDistance = 0;
+  for (size_t idx = 0; idx < kNumStates; ++idx) {
+    const SO3::State to = batch.get(idx);
+    const double norm = sqrt(to.x*to.x + to.y*to.y + to.z*to.z + to.w*to.w);
+    maxNormError = max(maxNormError, fabs(norm - 1.0));
+
+    const double distance = space.distance(from, to);
+    const double lowerBound = space.distanceLowerBound(from, to);
+    if (lowerBound > distance) {
+      ++numAboveDistance;
+    }
+    maxBatchError = max(maxBatchError, fabs(distances[idx] - distance));
+    maxBatchError = max(maxBatchError, fabs(lowerBounds[idx] - lowerBound));
+
+    maxEndpointError = max(maxEndpointError, space.distance(space.interpolate(from, to, 0.0), from));
+    maxEndpointError = max(maxEndpointError, space.distance(space.interpolate(from, to, 1.0), to));
+
+    const SO3::State mid = space.interpolate(from, to, 0.5);
+    maxMidpointError = max(maxMidpointError, fabs(space.distance(from, mid) - 0.5*distance));
+    maxMidpointError = max(maxMidpointError, fabs(space.distance(mid, to) - 0.5*distance));
+    maxBatchError = max(maxBatchError, space.distance(midBatch.get(idx), mid));
+  }
+
+  cout << "max norm error " << maxNormError << ", " << numAboveDistance
+       << " lower bounds above the distance, max batch error " << maxBatchError << endl;
+  cout << "max slerp endpoint error " << maxEndpointError
+       << ", max midpoint error " << maxMidpointError << endl;
+}
+
+//
+// A static compound SO2 x R^2 space against a Compound::Space with the
+// same subspaces and weights: sampled states copied across should have
+// the same distances and interpolations, and the spaces the same
+// dimension, extent and measure.  The distanceMany timings are for
+// reference.
+//
+static void checkStaticCompoundSpace ()
+{
+  typedef spaces::StaticCompound::Space<SO2::Space, RealVector::Space<2>> StaticSpaceType;
+  const size_t kNumStates = 100000;
+
+  StaticSpaceType staticSpace{RandomNumberGenerator{9}, SO2::Space{}, RealVector::Space<2>{-1.0, 1.0}};
+  staticSpace.setSubspaceWeight(1, 0.5);
+
+  spaces::Compound::Space compSpace;
+  compSpace.addSubspace(SO2::Space{});
+  compSpace.addSubspace(RealVector::Space<2>{-1.0, 1.0}, 0.5);
+
+  vector<StaticSpaceType::StateType> staticStates;
+  vector<spaces::Compound::State> compStates;
+  staticStates.reserve(kNumStates);
+  compStates.reserve(kNumStates);
+  for (size_t idx = 0; idx < kNumStates; ++idx) {
+    staticStates.push_back(staticSpace.sampleUniform());
+    compStates.push_back(compSpace.makeState());
+    compStates.back().getSubstate<SO2::State>(0) = staticStates.back().getSubstate<0>();
+    compStates.back().getSubstate<RealVector::State<2>>(1) = staticStates.back().getSubstate<1>();
+  }
+
+  vector<double> staticDistances(kNumStates);
+  vector<double> compDistances(kNumStates);
+  const auto staticStart = chrono::steady_clock::now();
+  staticSpace.distanceMany(staticStates[0], staticStates.data(), kNumStates, staticDistances.data());
+  const auto staticStop = chrono::steady_clock::now();
+  compSpace.distanceMany(compStates[0], compStates.data(), kNumStates, compDistances.data());
+  const auto compStop = chrono::steady_clock::now();
+
+  double maxDistanceError = 0.0;
+  double maxInterpolateError = 0.0;
+  auto staticMid = staticSpace.makeState();
+  auto compMid = compSpace.makeState();
+  for (size_t idx = 1; idx < kNumStates; ++idx) {
+    maxDistanceError = max(maxDistanceError, fabs(staticDistances[idx] - compDistances[idx]));
+    maxDistanceError = max(maxDistanceError, fabs(staticSpace.distance(staticStates[idx - 1], staticStates[idx]) -
+                                                  compSpace.distance(compStates[idx - 1], compStates[idx])));
+
+    staticSpace.interpolate(staticStates[idx - 1], staticStates[idx], 0.3, staticMid);
+    compSpace.interpolate(compStates[idx - 1], compStates[idx], 0.3, compMid);
+    const auto& staticValues = staticMid.getSubstate<1>().values;
+    const auto& compValues = compMid.getSubstate<RealVector::State<2>>(1).values;
+    maxInterpolateError = max(maxInterpolateError, SO2::Space{}.distance(staticMid.getSubstate<0>(), compMid.getSubstate<SO2::State>(0)));
+    maxInterpolateError = max(maxInterpolateError, fabs(staticValues[0] - compValues[0]));
+    maxInterpolateError = max(maxInterpolateError, fabs(staticValues[1] - compValues[1]));
+  }
+
+  cout << "dimension " << staticSpace.getDimension() << " vs " << compSpace.getDimension()
+       << ", extent " << staticSpace.getMaximumExtent() << " vs " << compSpace.getMaximumExtent()
+       << ", measure " << staticSpace.getMeasure() << " vs " << compSpace.getMeasure() << endl;
+  cout << "max distance error " << maxDistanceError
+       << ", max interpolation error " << maxInterpolateError << endl;
+  cout << kNumStates << " distances: static "
+       << chrono::duration<double, micro>(staticStop - staticStart).count() << " us, compound "
+       << chrono::duration<double, micro>(compStop - staticStop).count() << " us" << endl;
+}
+
+//
+// Write 3000 states of a compound SO2 x R^2 x SO3 space, enough to
+// make the writer grow its file twice, read them back and compare them
+// exactly.  A reader for a space with another schema should refuse
+// the file.
+//
+static void checkStateArrayFile ()
+{
+  const size_t kNumStates = 3000;
+  const string path = (filesystem::temp_directory_path() / "ompl_state_array_check.bin").string();
+
+  spaces::Compound::Space compSpace{RandomNumberGenerator{13}};
+  compSpace.addSubspace(SO2::Space{});
+  compSpace.addSubspace(RealVector::Space<2>{-5.0, 5.0});
+  compSpace.addSubspace(SO3::Space{});
+
+  vector<spaces::Compound::State> states;
+  {
+    StateArrayWriter<spaces::Compound::Space> writer{compSpace, path};
+    for (size_t idx = 0; idx < kNumStates; ++idx) {
+      states.push_back(compSpace.sampleUniform());
+      writer.append(states.back());
+    }
+  }
+
+  size_t numMismatched = 0;
+  StateArrayReader<spaces::Compound::Space> reader{compSpace, path};
+  auto state = compSpace.makeState();
+  for (size_t idx = 0; idx < reader.size(); ++idx) {
+    reader.read(idx, state);
+    const auto& values = state.getSubstate<RealVector::State<2>>(1).values;
+    const auto& expectedValues = states[idx].getSubstate<RealVector::State<2>>(1).values;
+    if (state.getSubstate<SO2::State>(0).theta_rad != states[idx].getSubstate<SO2::State>(0).theta_rad ||
+        values[0] != expectedValues[0] || values[1] != expectedValues[1] ||
+        state.getSubstate<SO3::State>(2) != states[idx].getSubstate<SO3::State>(2)) {
+      ++numMismatched;
+    }
+  }
+  cout << "read back " << reader.size() << " of " << kNumStates << " states, "
+       << numMismatched << " mismatched" << endl;
+
+  spaces::Compound::Space otherSpace;
+  otherSpace.addSubspace(SO2::Space{});
+  otherSpace.addSubspace(RealVector::Space<2>{-5.0, 5.0});
+  try {
+    StateArrayReader<spaces::Compound::Space> otherReader{otherSpace, path};
+    cout << "reader with another schema opened the file" << endl;
+  }
+  catch (const runtime_error& ex) {
+    cout << "reader with another schema refused: " << ex.what() << endl;
+  }
+
+  filesystem::remove(path);
+}
+
+//
+// The disc obstacle, counting the checks that reach it.  Copies share
+// the count.
+//
+struct CountingDiscObstacleChecker : DiscObstacleChecker
+{
+  bool isValid (const StateType& state) const
+  {
+    ++*spNumChecks;
+    return DiscObstacleChecker::isValid(state);
+  }
+
+  shared_ptr<size_t> spNumChecks = make_shared<size_t>(0);
+};
+
+//
+// Check 400 states of a 20x20 grid over the disc obstacle ten times
+// over in shuffled order, the first half one at a time and the rest
+// batched.  With room for every state, the cache should pass each on
+// once and answer the other 3600 lookups itself.  With room for only
+// eight buckets it evicts, but its answers should still match the
+// disc's.
+//
+static void checkCachedValidityChecker ()
+{
+  typedef CachedStateValidityChecker<CountingDiscObstacleChecker> CacheType;
+  const size_t kGridSize = 20;
+  const size_t kNumRepeats = 10;
+
+  vector<RealVector::State<2>> states;
+  for (size_t repeat = 0; repeat < kNumRepeats; ++repeat) {
+    for (size_t row = 0; row < kGridSize; ++row) {
+      for (size_t col = 0; col < kGridSize; ++col) {
+        RealVector::State<2> state;
+        state.values[0] = (col + 0.5)/kGridSize;
+        state.values[1] = (row + 0.5)/kGridSize;
+        states.push_back(state);
+      }
+    }
+  }
+  RandomNumberGenerator rng{17};
+  for (size_t idx = states.size() - 1; idx > 0; --idx) {
+    swap(states[idx], states[rng.uintBelow(idx + 1)]);
+  }
+  const size_t half = states.size()/2;
+
+  for (size_t maxBytes : { size_t{1} << 20, size_t{512} }) {
+    CountingDiscObstacleChecker checker;
+    CacheType cache{checker, RealVector::Space<2>{}, 1e-3, maxBytes};
+
+    size_t numDisagreements = 0;
+    for (size_t idx = 0; idx < half; ++idx) {
+      if (cache.isValid(states[idx]) != DiscObstacleChecker{}.isValid(states[idx])) {
+        ++numDisagreements;
+      }
+    }
+    vector<uint64_t> validMask(getValidMaskWords(states.size() - half));
+    cache.isValidMany(states.data() + half, states.size() - half, validMask.data());
+    for (size_t idx = half; idx < states.size(); ++idx) {
+      if (isValidMaskBitSet(validMask.data(), idx - half) != DiscObstacleChecker{}.isValid(states[idx])) {
+        ++numDisagreements;
+      }
+    }
+
+    const auto statistics = cache.getStatistics();
+    cout << "capacity " << cache.getCapacity() << ": " << statistics.numHits << " hits, "
+         << statistics.numMisses << " misses, " << statistics.numEvictions << " evictions, "
+         << *checker.spNumChecks << " checks passed on, " << numDisagreements << " disagreements" << endl;
+  }
+}
+
+//
+// Nanoseconds per draw, best of five runs, for xoshiro256++ as a typed
+// generator and behind AnyEngine.  For reference only: the difference
+// is the per-draw dispatch, which bulk draws pay once per block.
+//
+template <typename GeneratorType>
+static void timeDraws (const char* name, GeneratorType rng)
+{
+  const size_t kNumDraws = 2000000;
+  double sum = 0.0;
+  vector<double> block(4096);
+
+  auto bestNsPerDraw = [&] (auto&& draw) {
+    double best = 1e300;
+    for (int run = 0; run < 5; ++run) {
+      const auto start = chrono::steady_clock::now();
+      draw();
+      const auto stop = chrono::steady_clock::now();
+      best = min(best, chrono::duration<double, nano>(stop - start).count()/kNumDraws);
+    }
+    return best;
+  };
+  const double uniform = bestNsPerDraw([&] {
+      for (size_t idx = 0; idx < kNumDraws; ++idx) {
+        sum += rng.realUniform_0_1();
+      }
+    });
+  const double below = bestNsPerDraw([&] {
+      for (size_t idx = 0; idx < kNumDraws; ++idx) {
+        sum += rng.uintBelow(1000);
+      }
+    });
+  const double bulk = bestNsPerDraw([&] {
+      for (size_t idx = 0; idx < kNumDraws; idx += block.size()) {
+        rng.realUniform_0_1(block.data(), block.size());
+        sum += block[0];
+      }
+    });
+
+  cout << name << " uniform " << uniform << " ns, uintBelow " << below
+       << " ns, bulk uniform " << bulk << " ns (" << (sum > 0.0 ? "ok" : "?") << ")" << endl;
+}
+
+static void checkEngineDispatch ()
+{
+  timeDraws("typed xoshiro256++:   ", Xoshiro256RandomNumberGenerator{21});
+  timeDraws("AnyEngine xoshiro256++:", RandomNumberGenerator{21});
+}
+
+//
+// GNAT over SO2 angles, with leaves scanned one distance at a time and
+// with SO2::Space::distanceMany: the neighbors found should be the
+// same.  The timings are for reference only: an SO2 distance takes a
+// few nanoseconds and a query scans only a few dozen leaf elements,
+// so the two are within noise of each other here.
+//
+static void checkGnatBatchDistance ()
+{
+  typedef ompl::NearestNeighborsGNATNoThreadSafety<SO2::State> Gnat;
+
+  const SO2::Space space;
+  const auto distance = [&space] (const SO2::State& fromState, const SO2::State& toState) {
+    return space.distance(fromState, toState);
+  };
+  const auto distanceMany = [&space] (const SO2::State& fromState, const SO2::State* toStates, size_t numStates,
+                                      double* outDistances) {
+    space.distanceMany(fromState, toStates, numStates, outDistances);
+  };
+
+  RandomNumberGenerator rng{3};
+  vector<SO2::State> states(20000);
+  vector<SO2::State> queries(2000);
+  for (auto& state : states) {
+    space.sampleUniform(state, rng);
+  }
+  for (auto& query : queries) {
+    space.sampleUniform(query, rng);
+  }
+
+  Gnat scalarGnat;
+  Gnat batchGnat;
+  scalarGnat.setDistanceFunction(distance);
+  batchGnat.setDistanceFunction(distance);
+  batchGnat.setBatchDistanceFunction(distanceMany);
+  scalarGnat.add(states);
+  batchGnat.add(states);
+
+  size_t numDifferent = 0;
+  vector<SO2::State> scalarNeighbors;
+  vector<SO2::State> batchNeighbors;
+  for (const auto& query : queries) {
+    scalarGnat.nearestK(query, 10, scalarNeighbors);
+    batchGnat.nearestK(query, 10, batchNeighbors);
+    numDifferent += (scalarNeighbors != batchNeighbors);
+
+    scalarGnat.nearestR(query, 0.002, scalarNeighbors);
+    batchGnat.nearestR(query, 0.002, batchNeighbors);
+    numDifferent += (scalarNeighbors != batchNeighbors);
+  }
+  cout << "nearestK/nearestR results differing: " << numDifferent << " of " << 2*queries.size() << endl;
+
+  for (const Gnat* pGnat : { &scalarGnat, &batchGnat }) {
+    const auto start = chrono::steady_clock::now();
+    for (const auto& query : queries) {
+      pGnat->nearestK(query, 10, scalarNeighbors);
+    }
+    const auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start);
+    cout << (pGnat == &scalarGnat ? "scalar" : "batch") << " leaf scans: "
+         << elapsed.count()/queries.size() << " us per nearestK" << endl;
+  }
+}
+
 int main ()
 {
   spaces::Compound::Space compSpace;
@@ -57,9 +923,56 @@ int main ()
 
   cout << "----- gaussian sampler -----" << endl;
   Samplers::GaussianSampler compSampler(move(compSpace), 1.0);
-  auto compState4 = compSpace.makeState();
+  auto compState4 = compSampler.getSpace()->makeState();
   compSampler.sample(compState4);
   draw(compState, cout, 0);
+
+  cout << "----- normal tails -----" << endl;
+  checkNormalTails();
+
+  cout << "----- sample producer pool shutdown -----" << endl;
+  checkPoolShutdown();
+
+  cout << "----- sample producer pool validator streams -----" << endl;
+  checkPoolValidatorStreams();
+
+  cout << "----- adaptive gaussian stddev -----" << endl;
+  checkStddevAdaptation();
+
+  cout << "----- gaussian stddev check-time budget -----" << endl;
+  checkStddevCostBudget();
+
+  cout << "----- compound state copy failure -----" << endl;
+  checkStateCopyFailure();
+
+  cout << "----- gnat batch leaf distances -----" << endl;
+  checkGnatBatchDistance();
+
+  cout << "----- fixed-point SO2 against SO2 -----" << endl;
+  checkFixedPointSo2<SO2::Space16>("16-bit");
+  checkFixedPointSo2<SO2::Space32>("32-bit");
+
+  cout << "----- narrow passage samplers -----" << endl;
+  checkNarrowPassageSamplers<NarrowPassageChecker>("one at a time,");
+  checkNarrowPassageSamplers<BatchNarrowPassageChecker>("batched,");
+
+  cout << "----- quasi-random sampler -----" << endl;
+  checkQuasiRandomSampler();
+
+  cout << "----- SO3 space -----" << endl;
+  checkSo3Space();
+
+  cout << "----- static compound space -----" << endl;
+  checkStaticCompoundSpace();
+
+  cout << "----- state array file -----" << endl;
+  checkStateArrayFile();
+
+  cout << "----- cached validity checker -----" << endl;
+  checkCachedValidityChecker();
+
+  cout << "----- engine dispatch -----" << endl;
+  checkEngineDispatch();
 }
 
 #if 0
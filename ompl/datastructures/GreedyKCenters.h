@@ -91,7 +91,7 @@ namespace ompl
             if (dists.size1() < data.size() || dists.size2() < k)
                 dists.resize(std::max(2 * dists.size1() + 1, data.size()), k, false);
             // first center is picked randomly
-            centers.push_back(rng_.intUniform(0, data.size() - 1));
+            centers.push_back(rng_.uintBelow(data.size()));
             for (unsigned i = 1; i < k; ++i)
             {
                 unsigned ind;
@@ -86,6 +86,11 @@ namespace ompl
         /// \endcond
 
     public:
+        /** \brief The definition of a one-to-many distance function: it
+            stores in \c out[i] the distance from its first argument to
+            each of the \c count elements pointed to by its second */
+        using BatchDistanceFunction = std::function<void(const _T &, const _T *, std::size_t, double *)>;
+
         NearestNeighborsGNATNoThreadSafety(unsigned int degree = 8, unsigned int minDegree = 4,
                                            unsigned int maxDegree = 12, unsigned int maxNumPtsPerLeaf = 50,
                                            unsigned int removedCacheSize = 500, bool rebalancing = false
@@ -123,6 +128,20 @@ namespace ompl
                 rebuildDataStructure();
         }
 
+        /// \brief Set a one-to-many distance function to use when scanning
+        /// the elements stored in a leaf. It must agree with the distance
+        /// function; if none is set, leaves are scanned one distance at a time.
+        void setBatchDistanceFunction(const BatchDistanceFunction &batchDistFun)
+        {
+            batchDistFun_ = batchDistFun;
+        }
+
+        /// \brief Get the one-to-many distance function used for leaf scans
+        const BatchDistanceFunction &getBatchDistanceFunction() const
+        {
+            return batchDistFun_;
+        }
+
         void clear() override
         {
             if (tree_)
@@ -372,6 +391,18 @@ namespace ompl
                 node->nearestR(*this, data, radius);
             }
         }
+
+        class Node;
+
+        /// \brief Compute, in one call to the batch distance function, the
+        /// distances from data to every element stored in node.
+        const std::vector<double> &leafDistances(const Node &node, const _T &data) const
+        {
+            leafDistances_.resize(node.data_.size());
+            batchDistFun_(data, node.data_.data(), node.data_.size(), leafDistances_.data());
+            return leafDistances_;
+        }
+
         /// \brief Convert the internal data structure used for storing neighbors
         /// to the vector that NearestNeighbor API requires.
         void postprocessNearest(std::vector<_T> &nbh) const
@@ -562,12 +593,23 @@ namespace ompl
             void nearestK(const GNAT &gnat, const _T &data, std::size_t k, bool &isPivot) const
             {
                 NearQueue &nbh = gnat.nearQueue_;
-                for (unsigned int i = 0; i < data_.size(); ++i)
-                    if (!gnat.isRemoved(data_[i]))
-                    {
-                        if (insertNeighborK(nbh, k, data_[i], data, gnat.distFun_(data, data_[i])))
-                            isPivot = false;
-                    }
+                if (gnat.batchDistFun_ && !data_.empty())
+                {
+                    const std::vector<double> &dists = gnat.leafDistances(*this, data);
+                    for (unsigned int i = 0; i < data_.size(); ++i)
+                        if (!gnat.isRemoved(data_[i]))
+                        {
+                            if (insertNeighborK(nbh, k, data_[i], data, dists[i]))
+                                isPivot = false;
+                        }
+                }
+                else
+                    for (unsigned int i = 0; i < data_.size(); ++i)
+                        if (!gnat.isRemoved(data_[i]))
+                        {
+                            if (insertNeighborK(nbh, k, data_[i], data, gnat.distFun_(data, data_[i])))
+                                isPivot = false;
+                        }
                 if (!children_.empty())
                 {
                     double dist;
@@ -616,9 +658,17 @@ namespace ompl
                 NearQueue &nbh = gnat.nearQueue_;
                 double dist = r;  // note difference with nearestK
 
-                for (unsigned int i = 0; i < data_.size(); ++i)
-                    if (!gnat.isRemoved(data_[i]))
-                        insertNeighborR(nbh, r, data_[i], gnat.distFun_(data, data_[i]));
+                if (gnat.batchDistFun_ && !data_.empty())
+                {
+                    const std::vector<double> &dists = gnat.leafDistances(*this, data);
+                    for (unsigned int i = 0; i < data_.size(); ++i)
+                        if (!gnat.isRemoved(data_[i]))
+                            insertNeighborR(nbh, r, data_[i], dists[i]);
+                }
+                else
+                    for (unsigned int i = 0; i < data_.size(); ++i)
+                        if (!gnat.isRemoved(data_[i]))
+                            insertNeighborR(nbh, r, data_[i], gnat.distFun_(data, data_[i]));
                 if (!children_.empty())
                 {
                     Node *child;
@@ -792,6 +842,8 @@ namespace ompl
         /// removed_ cache. If the cache is full, the tree will be rebuilt with
         /// the elements in removed_ actually removed from the tree.
         std::size_t removedCacheSize_;
+        /// \brief The one-to-many distance function used for leaf scans (optional)
+        BatchDistanceFunction batchDistFun_;
         /// \brief The data structure used to split data into subtrees.
         GreedyKCenters<_T> pivotSelector_;
         /// \brief Cache of removed elements.
@@ -809,6 +861,8 @@ namespace ompl
         mutable std::vector<unsigned int> pivots_;
         /// \brief Matrix of distances to pivots
         mutable typename GreedyKCenters<_T>::Matrix distances_;
+        /// \brief Distances from the query to the elements of the leaf being scanned
+        mutable std::vector<double> leafDistances_;
 /// \}
 
 #ifdef GNAT_SAMPLER
@@ -37,7 +37,9 @@
 #ifndef OMPL_DATASTRUCTURES_PERMUTATION_
 #define OMPL_DATASTRUCTURES_PERMUTATION_
 
-#include <random>
+#include "RandomNumberGenerator.h"
+#include <utility>
+#include <vector>
 
 namespace ompl
 {
@@ -54,6 +56,12 @@ namespace ompl
         {
             permute(n);
         }
+        /// \brief Create a permutation of the numbers 0, ... , n - 1,
+        /// shuffled with (a copy of) the given stream
+        Permutation(std::size_t n, const RandomNumberGenerator &rng) : std::vector<int>(n), rng_(rng)
+        {
+            permute(n);
+        }
         /// \brief Create a permutation of the numbers 0, ..., n - 1
         void permute(unsigned int n)
         {
@@ -61,12 +69,16 @@ namespace ompl
                 resize(n);
             for (unsigned int i = 0; i < n; ++i)
                 operator[](i) = i;
-            std::shuffle(begin(), begin() + n, generator_);
+            // Fisher-Yates shuffle with unbiased bounded draws
+            for (unsigned int i = n; i > 1; --i)
+                std::swap(operator[](i - 1), operator[](rng_.uintBelow(i)));
         }
 
     private:
-        /// Mersenne twister random number generator
-        std::mt19937 generator_;
+        /// Random number generator used to shuffle; fixed-seeded by
+        /// default, like the std::mt19937 it replaced, so that
+        /// permutations are reproducible
+        RandomNumberGenerator rng_{0};
     };
 }
 